@@ -0,0 +1,340 @@
+/*
+ * svd_bench: times svd(), svd_sort() and svd_invs() on a set of shapes and
+ * prints the results as JSON.
+ *
+ * Usage: svd_bench [-r <reps>] [-t <seconds>] [-s <m>x<n>[:<cond>]] ...
+ *   -r  maximal number of repetitions of a case (default 50)
+ *   -t  time budget of a case, in seconds (default 1); at least 5
+ *       repetitions are made
+ *   -s  benchmarks the given shape (repeatable) instead of the default set;
+ *       cond > 1 prescribes geometrically decaying singular values from 1
+ *       to 1/cond (svd_gen())
+ *
+ * The matrices are Gaussian random, or generated by svd_gen() with a
+ * prescribed spectrum (svd_spectrum()) for the ill-conditioned, graded,
+ * clustered and rank-deficient cases. Each repetition decomposes a fresh
+ * copy of the matrix; the copy is not timed. Latencies are reported as
+ * median and 99th percentile (nearest rank) in milliseconds, with the
+ * GFLOP/s of the median from nominal operation counts:
+ *   svd():      min(14mn^2 + 8n^3, 6mn^2 + 20n^3) for m >= n, the thin SVD
+ *               by Golub-Reinsch and by R-SVD (Golub & Van Loan),
+ *               with m and n swapped for m < n;
+ *   svd_invs(): 2mnk, k = min(m,n);
+ *   svd_sort(): none (reported as null).
+ * The phases inside svd() and svd_sort() are timed through svd_stat and
+ * reported in the same form, with the flop estimates of the library, along
+ * with the counters of the QR sweep.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <chrono>
+
+#include "svd.hpp"
+
+#define BENCH_REPS 50           /* maximal repetitions of a case */
+#define BENCH_MINREPS 5         /* minimal repetitions of a case */
+#define BENCH_TIME 1.0          /* time budget of a case, seconds */
+#define BENCH_MAXSHAPES 64
+
+enum { PH_SVD, PH_SORT, PH_INVS, PH_TOTAL, NPHASES };
+
+static const char* phase_names[NPHASES] = { "svd", "svd_sort", "svd_invs", "total" };
+
+static const char* stat_names[SVD_NPHASE] = { "qr", "bidiag", "accum_right", "accum_left", "diag", "back", "sort" };
+
+struct bcase {
+    const char* kind;           /* square, tall, wide, batched, illcond,
+                                 * graded, clustered, rankdef, custom */
+    int m, n;
+    int count;                  /* matrices in a batch, 1 otherwise */
+    int mode;                   /* spectrum (SVD_SPEC_*), 0 for Gaussian */
+    double cond;                /* condition number of the spectrum */
+    int rank;                   /* rank of the spectrum, 0 for full */
+    int graded;                 /* see svd_gen() */
+};
+
+static const struct bcase default_cases[] = {
+    { "square", 32, 32, 1, 0, 1.0, 0, 0 },
+    { "square", 128, 128, 1, 0, 1.0, 0, 0 },
+    { "square", 512, 512, 1, 0, 1.0, 0, 0 },
+    { "tall", 4000, 100, 1, 0, 1.0, 0, 0 },
+    { "tall", 10000, 200, 1, 0, 1.0, 0, 0 },
+    { "wide", 100, 4000, 1, 0, 1.0, 0, 0 },
+    { "batched", 4, 4, 10000, 0, 1.0, 0, 0 },
+    { "batched", 16, 8, 2000, 0, 1.0, 0, 0 },
+    { "illcond", 256, 256, 1, SVD_SPEC_GEOMETRIC, 1e12, 0, 0 },
+    { "graded", 256, 256, 1, SVD_SPEC_GEOMETRIC, 1e12, 0, 1 },
+    { "clustered", 256, 256, 1, SVD_SPEC_ONELARGE, 1e6, 0, 0 },
+    { "rankdef", 256, 256, 1, SVD_SPEC_GEOMETRIC, 1e3, 128, 0 },
+};
+
+static unsigned long long rng_state = 0x9e3779b97f4a7c15ULL;
+
+static double urand()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+
+    return ((rng_state >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static double nrand()
+{
+    return sqrt(-2.0 * log(urand())) * cos(2.0 * 3.14159265358979323846 * urand());
+}
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int cmp_double(const void* p1, const void* p2)
+{
+    double v1 = *(const double*) p1;
+    double v2 = *(const double*) p2;
+
+    return (v1 > v2) - (v1 < v2);
+}
+
+/* Nominal operation count of svd() for an m x n matrix. */
+static double svd_flops(double m, double n)
+{
+    double gr, rsvd;
+
+    if (m < n) {
+        double t = m;
+
+        m = n;
+        n = t;
+    }
+    gr = 14.0 * m * n * n + 8.0 * n * n * n;
+    rsvd = 6.0 * m * n * n + 20.0 * n * n * n;
+
+    return (gr < rsvd) ? gr : rsvd;
+}
+
+/* Fills A [0..m-1][0..n-1] with normal random numbers, or generates it
+ * with the spectrum of the case. */
+static void fill(double* A, const struct bcase* c, unsigned int seed)
+{
+    int m = c->m, n = c->n;
+    int i, j;
+
+    if (c->mode == 0) {
+        for (i = 0; i < m; i++)
+            for (j = 0; j < n; j++)
+                A[(size_t) i * n + j] = nrand();
+    } else {
+        int k = (m < n) ? m : n;
+        double* sigma = (double*)(malloc(k * sizeof(double)));
+        double** Ar = (double**)(malloc(m * sizeof(double*)));
+
+        for (i = 0; i < m; i++)
+            Ar[i] = &A[(size_t) i * n];
+        svd_spectrum(k, c->mode, c->cond, c->rank, seed, sigma);
+        svd_gen(Ar, n, m, sigma, c->graded, seed);
+        free(sigma);
+        free(Ar);
+    }
+}
+
+/* Prints "name": {median, p99, gflops} for the times t [0..nreps-1]
+ * (sorted on exit). */
+static void print_phase(const char* name, double* t, int nreps, double flops, int last)
+{
+    double med, p99;
+    int r99 = (int) ceil(0.99 * nreps) - 1;
+
+    qsort(t, nreps, sizeof(double), cmp_double);
+    med = (nreps % 2) ? t[nreps / 2] : 0.5 * (t[nreps / 2 - 1] + t[nreps / 2]);
+    p99 = t[(r99 < 0) ? 0 : r99];
+    printf("        \"%s\": {\"median_ms\": %.6g, \"p99_ms\": %.6g, \"gflops\": ", name, 1e3 * med, 1e3 * p99);
+    if (flops > 0.0 && med > 0.0)
+        printf("%.4g}", 1e-9 * flops / med);
+    else
+        printf("null}");
+    printf(last ? "\n" : ",\n");
+}
+
+/* Runs one case and prints its JSON object. */
+static void run_case(const struct bcase* c, int maxreps, double budget, int last)
+{
+    int m = c->m, n = c->n;
+    int k = (m < n) ? m : n;
+    size_t size = (size_t) m * n * c->count;
+    double* A0 = (double*)(malloc(size * sizeof(double)));
+    double* t[NPHASES];
+    double* ts[SVD_NPHASE];
+    double flops[NPHASES];
+    struct svd_stats st;
+    double start;
+    int nreps, p, b;
+
+    for (b = 0; b < c->count; b++)
+        fill(&A0[(size_t) b * m * n], c, b);
+    for (p = 0; p < NPHASES; p++)
+        t[p] = (double*)(calloc(maxreps, sizeof(double)));
+    for (p = 0; p < SVD_NPHASE; p++)
+        ts[p] = (double*)(calloc(maxreps, sizeof(double)));
+    memset(&st, 0, sizeof(st));
+    flops[PH_SVD] = svd_flops(m, n) * c->count;
+    flops[PH_SORT] = 0.0;
+    flops[PH_INVS] = 2.0 * m * n * k;
+    flops[PH_TOTAL] = flops[PH_SVD] + flops[PH_INVS];
+
+    fprintf(stderr, "svd_bench: %s %d x %d", c->kind, m, n);
+    if (c->count > 1)
+        fprintf(stderr, " (batch of %d)", c->count);
+    fflush(stderr);
+
+    start = now();
+    if (c->count > 1) {
+        double* A = (double*)(malloc(size * sizeof(double)));
+        double* w = (double*)(malloc((size_t) k * c->count * sizeof(double)));
+        double* V = (double*)(malloc((size_t) n * k * c->count * sizeof(double)));
+
+        for (nreps = 0; nreps < maxreps && (nreps < BENCH_MINREPS || now() - start < budget); nreps++) {
+            double t0;
+
+            memcpy(A, A0, size * sizeof(double));
+            t0 = now();
+            svd_batched(c->count, &n, &m, 0, A, w, V);
+            t[PH_SVD][nreps] = t[PH_TOTAL][nreps] = now() - t0;
+        }
+        free(A);
+        free(w);
+        free(V);
+    } else {
+        double** A = (double**)(alloc2d(n, m, sizeof(double)));
+        double** V = (double**)(alloc2d(k, n, sizeof(double)));
+        double** Ainv = (double**)(alloc2d(m, n, sizeof(double)));
+        double* w = (double*)(malloc(k * sizeof(double)));
+
+        for (nreps = 0; nreps < maxreps && (nreps < BENCH_MINREPS || now() - start < budget); nreps++) {
+            double t0, t1, t2, t3;
+
+            memcpy(&A[0][0], A0, size * sizeof(double));
+            memset(&st, 0, sizeof(st));
+            svd_stat = &st;
+            t0 = now();
+            svd(A, n, m, w, V);
+            t1 = now();
+            svd_sort(A, n, m, w, V);
+            t2 = now();
+            svd_stat = NULL;
+            svd_invs(A, n, m, w, V, Ainv);
+            t3 = now();
+            t[PH_SVD][nreps] = t1 - t0;
+            t[PH_SORT][nreps] = t2 - t1;
+            t[PH_INVS][nreps] = t3 - t2;
+            t[PH_TOTAL][nreps] = t3 - t0;
+            for (p = 0; p < SVD_NPHASE; p++)
+                ts[p][nreps] = st.time[p];
+        }
+        free2d(A);
+        free2d(V);
+        free2d(Ainv);
+        free(w);
+    }
+    fprintf(stderr, ": %d repetitions\n", nreps);
+
+    printf("    {\n");
+    printf("      \"kind\": \"%s\", \"m\": %d, \"n\": %d, \"count\": %d, \"mode\": %d, \"cond\": %g, \"rank\": %d, \"graded\": %d, \"reps\": %d,\n", c->kind, m, n, c->count, c->mode, c->cond, c->rank, c->graded, nreps);
+    printf("      \"phases\": {\n");
+    if (c->count > 1)
+        print_phase("svd_batched", t[PH_SVD], nreps, flops[PH_SVD], 1);
+    else
+        for (p = 0; p < NPHASES; p++)
+            print_phase(phase_names[p], t[p], nreps, flops[p], p == NPHASES - 1);
+    if (c->count > 1)
+        printf("      }\n");
+    else {
+        int plast = SVD_NPHASE - 1;
+
+        printf("      },\n");
+        printf("      \"svd_phases\": {\n");
+        while (plast > 0 && st.time[plast] == 0.0)
+            plast--;
+        for (p = 0; p <= plast; p++)
+            if (st.time[p] > 0.0)
+                print_phase(stat_names[p], ts[p], nreps, st.flops[p], p == plast);
+        printf("      },\n");
+        printf("      \"qr_sweep\": {\"singular_values\": %ld, \"steps\": %ld, \"steps_max\": %d, \"splits\": %ld, \"cancellations\": %ld}\n", st.nsv, st.its, st.itsmax, st.splits, st.cancellations);
+    }
+    printf(last ? "    }\n" : "    },\n");
+    fflush(stdout);
+
+    for (p = 0; p < NPHASES; p++)
+        free(t[p]);
+    for (p = 0; p < SVD_NPHASE; p++)
+        free(ts[p]);
+    free(A0);
+}
+
+static void usage()
+{
+    printf("Usage: svd_bench [-r <reps>] [-t <seconds>] [-s <m>x<n>[:<cond>]] ...\n");
+    printf("  -r  maximal number of repetitions of a case (default %d)\n", BENCH_REPS);
+    printf("  -t  time budget of a case in seconds (default %g); at least %d\n", BENCH_TIME, BENCH_MINREPS);
+    printf("      repetitions are made\n");
+    printf("  -s  benchmarks the given shape instead of the default set\n");
+    printf("      (repeatable); cond > 1 gives geometrically decaying singular\n");
+    printf("      values from 1 to 1/cond\n");
+    printf("Prints JSON to stdout: median and p99 latency, GFLOP/s, per phase\n");
+    printf("(svd, svd_sort, svd_invs) for square, tall, wide, batched,\n");
+    printf("ill-conditioned, graded, clustered and rank-deficient inputs, and\n");
+    printf("the same for the phases inside svd() and svd_sort(), with the\n");
+    printf("counters of the QR sweep.\n");
+    exit(0);
+}
+
+int main(int argc, char* argv[])
+{
+    struct bcase shapes[BENCH_MAXSHAPES];
+    const struct bcase* cases = default_cases;
+    int ncases = sizeof(default_cases) / sizeof(default_cases[0]);
+    int nshapes = 0;
+    int maxreps = BENCH_REPS;
+    double budget = BENCH_TIME;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "-r") == 0)
+            maxreps = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-t") == 0)
+            budget = atof(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-s") == 0 && nshapes < BENCH_MAXSHAPES) {
+            struct bcase* c = &shapes[nshapes++];
+
+            c->kind = "custom";
+            c->count = 1;
+            c->cond = 1.0;
+            c->rank = 0;
+            c->graded = 0;
+            if (sscanf(argv[++i], "%dx%d:%lf", &c->m, &c->n, &c->cond) < 2 || c->m <= 0 || c->n <= 0 || c->cond < 1.0)
+                usage();
+            c->mode = (c->cond > 1.0) ? SVD_SPEC_GEOMETRIC : 0;
+        } else
+            usage();
+    }
+    if (maxreps < BENCH_MINREPS)
+        maxreps = BENCH_MINREPS;
+    if (nshapes > 0) {
+        cases = shapes;
+        ncases = nshapes;
+    }
+
+    printf("{\n");
+    printf("  \"benchmark\": \"svd\",\n");
+    printf("  \"cases\": [\n");
+    for (i = 0; i < ncases; i++)
+        run_case(&cases[i], maxreps, budget, i == ncases - 1);
+    printf("  ]\n");
+    printf("}\n");
+
+    return 0;
+}
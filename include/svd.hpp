@@ -1,44 +1,389 @@
 #if !defined(_SVD_H)
 #define _SVD_H
 
+#include <stddef.h>
+#include <complex>
+
 extern int svd_verbose;
 
+#define SVD_PHASE_QR 0          /* QR (m >= 2n) or LQ (m < n) reduction */
+#define SVD_PHASE_BIDIAG 1      /* Householder bidiagonalization */
+#define SVD_PHASE_RIGHT 2       /* accumulation of right-hand transformations */
+#define SVD_PHASE_LEFT 3        /* accumulation of left-hand transformations */
+#define SVD_PHASE_DIAG 4        /* diagonalization of the bidiagonal form */
+#define SVD_PHASE_BACK 5        /* U = Q.U_R or V = Q'.V_L after SVD_PHASE_QR */
+#define SVD_PHASE_SORT 6        /* svd_sort() */
+#define SVD_NPHASE 7
+
+/** Statistics of the decompositions, by phase (SVD_PHASE_*).
+ *
+ * If svd_stat is not NULL, svd(), svd_values(), svd_dc(), svd_jacobi(),
+ * svd_mt() and svd_sort(), and the functions that call them, add to
+ * *svd_stat; clear it before a call to get the statistics of that call. The
+ * flops are estimates from the dimensions (LAPACK's counts for the
+ * Householder phases) and, for the QR sweep, from the rotations actually
+ * applied; they are not estimated for the bdc() part of svd_dc() and for
+ * svd_jacobi(). Like svd_verbose, svd_stat is global: it must not be set
+ * while decompositions run in other threads. svd_batched() and the complex
+ * svd() do not record.
+ *
+ * With svd_verbose set, the time and flops of each phase are also printed
+ * to stderr as the phase ends.
+ */
+struct svd_stats {
+    double time[SVD_NPHASE];    /* wall time, s */
+    double flops[SVD_NPHASE];   /* floating-point operations (estimate) */
+    long nsv;                   /* singular values found by the QR sweep */
+    long its;                   /* QR steps */
+    int itsmax;                 /* most QR steps for one singular value */
+    long splits;                /* splits of the bidiagonal form at a newly
+                                 * negligible superdiagonal element */
+    long cancellations;         /* superdiagonal elements cancelled at a
+                                 * negligible diagonal element */
+};
+
+extern struct svd_stats* svd_stat;
+
+#define SVD_SPEC_ONELARGE 1     /* 1, 1/cond, ..., 1/cond */
+#define SVD_SPEC_ONESMALL 2     /* 1, ..., 1, 1/cond */
+#define SVD_SPEC_GEOMETRIC 3    /* cond^(-i/(k-1)) */
+#define SVD_SPEC_ARITHMETIC 4   /* 1 - (1 - 1/cond).i/(k-1) */
+#define SVD_SPEC_RANDOM 5       /* log-uniform in [1/cond, 1] */
+
+/** Allocates n1xn2 matrix of something, in one contiguous block. Note that
+ * it will be accessed as [n2][n1]. All matrices passed to the functions
+ * below are of this form.
+ * @param n1 Number of columns
+ * @param n2 Number of rows
+ * @param unitsize Size of an element
+ * @return Matrix (zeroed)
+ */
+void* alloc2d(int n1, int n2, size_t unitsize);
+
+/** Destroys a matrix allocated by alloc2d().
+ * @param pp Matrix
+ */
+void free2d(void* pp);
+
 /** Performs singular value decomposition for a dense matrix.
  * Borrowed from EISPACK (1972-1973).
  *
- * The input matrix A is presented as  A = U.W.V'.
+ * The input matrix A is presented as  A = U.W.V'. Only the k = min(m,n)
+ * singular triplets are formed: wide matrices (m < n) are reduced by a row
+ * LQ factorisation, i.e. A' is decomposed without being formed.
  *
- * @param A Input matrix A [0..m-1][0..n-1]; output matrix U
+ * @param A Input matrix A [0..m-1][0..n-1]; output matrix U [0..m-1][0..k-1]
  * @param n Number of columns
  * @param m Number of rows
- * @param w Ouput vector [0..n-1] that presents diagonal matrix W 
- * @param V output matrix V [0..n-1][0..n-1] (not transposed)
+ * @param w Ouput vector [0..k-1] that presents diagonal matrix W 
+ * @param V output matrix V [0..n-1][0..k-1] (not transposed)
  */
 void svd(double** a, int n, int m, double* w, double** v);
 
+/** Same as svd(double**, ...), in single precision (half the memory
+ * traffic, twice the vector width) and in extended precision. The
+ * tolerances scale with the machine epsilon of the type; the
+ * divide-and-conquer and Jacobi solvers below are double only.
+ */
+void svd(float** a, int n, int m, float* w, float** v);
+void svd(long double** a, int n, int m, long double* w, long double** v);
+
+/** Performs singular value decomposition for a dense complex matrix,
+ * A = U.W.V^H with W real.
+ *
+ * A is reduced to a real bidiagonal matrix by complex Householder
+ * reflectors, which is then diagonalised by the real QR sweep of svd(). This
+ * is several times cheaper than decomposing the 2m x 2n real embedding of A.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]; output matrix U [0..m-1][0..k-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Ouput vector [0..k-1] of singular values (not sorted)
+ * @param V output matrix V [0..n-1][0..k-1] (not conjugate-transposed)
+ */
+void svd(std::complex<double>** A, int n, int m, double* w, std::complex<double>** V);
+void svd(std::complex<float>** A, int n, int m, float* w, std::complex<float>** V);
+
+/** Computes singular values of a dense matrix only.
+ *
+ * Same as svd() but skips the accumulation of U and V and the rotation
+ * updates of the QR sweep, so no storage for V is needed.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]; destroyed
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Ouput vector [0..min(m,n)-1] of singular values (not sorted)
+ */
+void svd_values(double** A, int n, int m, double* w);
+void svd_values(float** A, int n, int m, float* w);
+void svd_values(long double** A, int n, int m, long double* w);
+
+/** Performs singular value decomposition with the divide-and-conquer
+ * solver for the bidiagonal form.
+ *
+ * Same as svd(), but the bidiagonal SVD is computed by divide and conquer
+ * (as LAPACK's dbdsdc), so that the singular vectors are updated by matrix
+ * products instead of one rotation at a time. Faster than svd() for larger
+ * matrices when the singular vectors are needed.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]; output matrix U [0..m-1][0..k-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Ouput vector [0..k-1] that presents diagonal matrix W 
+ * @param V output matrix V [0..n-1][0..k-1] (not transposed)
+ */
+void svd_dc(double** A, int n, int m, double* w, double** V);
+
+/** Performs singular value decomposition by the one-sided Jacobi method.
+ *
+ * Same as svd(), but the columns of A are orthogonalised by Jacobi
+ * rotations instead of going through the bidiagonal form. Small singular
+ * values of graded matrices are obtained to high relative accuracy, down
+ * to about eps times the largest column norm of A (smaller ones are
+ * rounding noise, as for svd()), and the independent rotations of each
+ * step run in parallel (with OpenMP).
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]; output matrix U [0..m-1][0..k-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Ouput vector [0..k-1] that presents diagonal matrix W 
+ * @param V output matrix V [0..n-1][0..k-1] (not transposed)
+ */
+void svd_jacobi(double** A, int n, int m, double* w, double** V);
+
+/** Performs singular value decomposition with a multithreaded QR sweep.
+ *
+ * Same as svd(), but the rotations of the QR sweep are applied to U and V
+ * by nthreads threads (with OpenMP), each updating its own block of rows
+ * of U and V with the whole rotation sequence.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]; output matrix U [0..m-1][0..k-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Ouput vector [0..k-1] that presents diagonal matrix W 
+ * @param V output matrix V [0..n-1][0..k-1] (not transposed)
+ * @param nthreads Number of threads; 0 for the OpenMP default
+ */
+void svd_mt(double** A, int n, int m, double* w, double** V, int nthreads);
+
+/** Performs singular value decomposition in single precision and refines
+ * it to double accuracy.
+ *
+ * Same as svd(), but the decomposition is computed in float and the
+ * singular values and vectors are then refined in double by an iteration
+ * made of matrix products (Ogita & Aishima), which converges quadratically:
+ * two or three steps for well-conditioned matrices. Each step costs about
+ * eight products of the size of A'.A. If the iteration stops converging
+ * before the accuracy of svd() (graded matrices, whose float decomposition
+ * is too far off), the decomposition is redone by svd().
+ *
+ * This is an opt-in mode, not a faster svd(): it only pays off where the
+ * float decomposition is several times faster than the double one and the
+ * matrix products run near peak. With the scalar float svd() and matmul()
+ * of this library it is 4 to 7 times slower than svd() (300x300: 0.58 s
+ * against 0.13 s), and graded matrices cost the float decomposition and a
+ * failed step on top of svd().
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]; output matrix U [0..m-1][0..k-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Ouput vector [0..k-1] that presents diagonal matrix W 
+ * @param V output matrix V [0..n-1][0..k-1] (not transposed)
+ * @return Number of refinement steps, or -1 if svd() was used instead
+ */
+int svd_mixed(double** A, int n, int m, double* w, double** V);
+
+/** Computes the k largest singular triplets of a matrix by thick-restart
+ * Golub-Kahan-Lanczos bidiagonalisation.
+ *
+ * A is only accessed through products with vectors and is not modified.
+ * Besides A, the storage needed is O((m+n).k), so this is the method of
+ * choice when a few triplets of a large matrix are needed. The triplets
+ * are sorted in order of decreasing singular values.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param k Number of triplets, 0 < k <= min(m,n)
+ * @param U Output matrix U [0..m-1][0..k-1]
+ * @param w Output vector [0..k-1] of singular values
+ * @param V Output matrix V [0..n-1][0..k-1] (not transposed)
+ * @param res Output vector [0..k-1] of residual norms |A'.u_i - w_i.v_i|
+ */
+void svd_topk(double** A, int n, int m, int k, double** U, double* w, double** V, double* res);
+
+/** Computes a rank-k approximation of a matrix by randomised SVD.
+ *
+ * The range of A is sampled by k+p Gaussian random vectors, refined by q
+ * power iterations, and the projection of A onto it is decomposed by svd().
+ * A is not modified and is only used in a few matrix products. Suited
+ * for approximate low-rank factorisations (e.g. PCA) of large matrices.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param k Rank, 0 < k <= min(m,n)
+ * @param p Oversampling (typically 5 to 10)
+ * @param q Number of power iterations (typically 0 to 2)
+ * @param seed Seed of the random number generator
+ * @param U Output matrix U [0..m-1][0..k-1]
+ * @param w Output vector [0..k-1] of singular values (decreasing)
+ * @param V Output matrix V [0..n-1][0..k-1] (not transposed)
+ * @param err Output a-posteriori estimate of the spectral norm of the
+ *            approximation error A - U.W.V' (holds with probability at least
+ *            1 - 1e-10), or NULL
+ */
+void svd_rand(double** A, int n, int m, int k, int p, int q, unsigned int seed, double** U, double* w, double** V, double* err);
+
+/** Updates a (possibly truncated) singular value decomposition
+ * A = U.W.V' of rank k for rows appended to A, by Brand's method.
+ *
+ * Only a core matrix of order k+r is decomposed, so the cost is
+ * O((m+n).(k+r)^2) rather than that of decomposing the updated matrix.
+ * The outputs must not overlap the inputs.
+ *
+ * @param m Number of rows of A
+ * @param n Number of columns of A
+ * @param k Rank of the decomposition
+ * @param U Input matrix U [0..m-1][0..k-1]
+ * @param w Input vector [0..k-1] of singular values
+ * @param V Input matrix V [0..n-1][0..k-1]
+ * @param r Number of new rows
+ * @param B New rows [0..r-1][0..n-1]
+ * @param kk Maximal rank of the updated decomposition (truncation)
+ * @param U1 Output matrix U [0..m+r-1][0..kk-1]
+ * @param w1 Output vector [0..kk-1] of singular values (decreasing)
+ * @param V1 Output matrix V [0..n-1][0..kk-1]
+ * @return Rank of the updated decomposition, at most kk
+ */
+int svd_addrows(int m, int n, int k, double** U, double* w, double** V, int r, double** B, int kk, double** U1, double* w1, double** V1);
+
+/** Same as svd_addrows() for c columns C [0..m-1][0..c-1] appended to A;
+ * U1 is [0..m-1][0..kk-1] and V1 [0..n+c-1][0..kk-1].
+ */
+int svd_addcols(int m, int n, int k, double** U, double* w, double** V, int c, double** C, int kk, double** U1, double* w1, double** V1);
+
+/** Same as svd_addrows() for the modification A + X.Y' of rank c, with
+ * X [0..m-1][0..c-1] and Y [0..n-1][0..c-1]; c = 1 is a rank-one update.
+ * U1 is [0..m-1][0..kk-1] and V1 [0..n-1][0..kk-1].
+ */
+int svd_update(int m, int n, int k, double** U, double* w, double** V, int c, double** X, double** Y, int kk, double** U1, double* w1, double** V1);
+
+/** Same as svd_addrows() for the removal of row row of A (downdating);
+ * U1 is [0..m-2][0..kk-1] and V1 [0..n-1][0..kk-1].
+ */
+int svd_delrow(int m, int n, int k, double** U, double* w, double** V, int row, int kk, double** U1, double* w1, double** V1);
+
+/** Source of rows for svd_stream(): reads up to nr rows of n values into
+ * X [0..nr-1][0..n-1] and returns the number of rows read, 0 at the end.
+ * A call with nr = 0 (and X NULL) restarts the source; it returns 0 on
+ * success.
+ */
+typedef int (*svd_rowsource)(void* p, int nr, int n, double** X);
+
+/** Sink of rows for svd_stream(): takes nr rows X [0..nr-1][0..n-1]. */
+typedef void (*svd_rowsink)(void* p, int nr, int n, double** X);
+
+/** Performs singular value decomposition of a tall matrix A [0..m-1][0..n-1]
+ * (m >= n) that is read by row blocks from src, out of core.
+ *
+ * A tall-skinny QR reduction tree brings A to an n x n R, on which svd() is
+ * run. If sink is not NULL, the source is restarted and a second pass writes
+ * U [0..m-1][0..n-1] to the sink, in order. Memory is O(b.n + n^2.log(m/b));
+ * the second pass also keeps (n + 1).n values per block in a temporary file.
+ *
+ * @param n Number of columns
+ * @param b Number of rows in a block (at least n), or 0 for the default
+ * @param src Row source
+ * @param psrc Data passed to src
+ * @param w Output vector [0..n-1] of singular values (decreasing)
+ * @param V Output matrix V [0..n-1][0..n-1] (not transposed)
+ * @param sink Row sink for U, or NULL for w and V only
+ * @param psink Data passed to sink
+ * @return Number of rows m
+ */
+int svd_stream(int n, int b, svd_rowsource src, void* psrc, double* w, double** V, svd_rowsink sink, void* psink);
+
+/** Computes a singular value distribution (SVD_SPEC_*), as the modes of
+ * LAPACK's dlatms: the first rank values go from 1 down to 1/cond, the
+ * others are zero.
+ *
+ * @param k Number of singular values
+ * @param mode Distribution (SVD_SPEC_*)
+ * @param cond Condition number of the nonzero values, >= 1
+ * @param rank Number of nonzero values, or 0 for k
+ * @param seed Seed of the random number generator (SVD_SPEC_RANDOM)
+ * @param sigma Output vector [0..k-1] (decreasing)
+ */
+void svd_spectrum(int k, int mode, double cond, int rank, unsigned int seed, double* sigma);
+
+/** Generates a test matrix A = U.S.V' with prescribed singular values S and
+ * random orthogonal U and V (as LAPACK's dlagge), in O(mn.min(m,n)) time
+ * and no extra storage.
+ *
+ * @param A Output matrix A [0..m-1][0..n-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param sigma Input vector [0..min(m,n)-1] of singular values
+ * @param graded If nonzero, the factor of the shorter dimension is the
+ *               identity, so that the columns (m >= n) or rows of A are
+ *               orthogonal with norms sigma
+ * @param seed Seed of the random number generator
+ */
+void svd_gen(double** A, int n, int m, const double* sigma, int graded, unsigned int seed);
+
+/** Performs singular value decomposition for a batch of small dense
+ * matrices.
+ *
+ * The matrices are stored one after another in contiguous arrays. Member
+ * i is m_i x n_i, with k_i = min(m_i,n_i):
+ *   A: m_i x n_i, row-major; on output U [0..m_i-1][0..k_i-1] with row
+ *      stride n_i;
+ *   w: k_i singular values (not sorted);
+ *   V: n_i x k_i, row-major (not transposed).
+ *
+ * The workspace is allocated once per call rather than per matrix, and with
+ * OpenMP the members are shared between threads by a dynamic schedule.
+ *
+ * @param count Number of matrices
+ * @param n Number of columns of each matrix [0..count-1], or of all matrices
+ *          if inc is 0
+ * @param m Number of rows of each matrix [0..count-1], or of all matrices if
+ *          inc is 0
+ * @param inc 1 for heterogeneous sizes, 0 for uniform sizes
+ * @param A Input matrices A; output matrices U
+ * @param w Output singular values
+ * @param V Output matrices V
+ */
+void svd_batched(int count, const int* n, const int* m, int inc, double* A, double* w, double* V);
+
 /** Performs sorting of SVD results in order of decreasing singular values.
  *
- * @param A Input-output matrix U [0..m-1][0..n-1]
+ * @param A Input-output matrix U [0..m-1][0..k-1], k = min(m,n)
  * @param n Number of columns
  * @param m Number of rows
- * @param w Input-ouput vector [0..n-1] that presents diagonal matrix W 
- * @param V Input-output matrix V [0..n-1][0..n-1] (not transposed)
+ * @param w Input-ouput vector [0..k-1] that presents diagonal matrix W 
+ * @param V Input-output matrix V [0..n-1][0..k-1] (not transposed)
  *
  * This function does the work but has downside that it requires temporal 
  * storage equal to the main storage. This may be  a problem for some large
  * applications, but one does not usually use dense SVD in such cases.
  */
 void svd_sort(double** A, int n, int m, double* w, double** V);
+void svd_sort(float** A, int n, int m, float* w, float** V);
+void svd_sort(long double** A, int n, int m, long double* w, long double** V);
 
 /** Performs inversion of a matrix using SVD.
  *
- * @param A Input matrix A [0..m-1][0..n-1]
+ * @param A Input matrix U [0..m-1][0..k-1], k = min(m,n)
  * @param n Number of columns
  * @param m Number of rows
- * @param w Input-ouput vector [0..n-1] that presents diagonal matrix W 
- * @param V Input-output matrix V [0..n-1][0..n-1] (not transposed)
- * @param A_inv Input matrix A [0..m-1][0..n-1]; output matrix AT
+ * @param w Input-ouput vector [0..k-1] that presents diagonal matrix W 
+ * @param V Input matrix V [0..n-1][0..k-1] (not transposed)
+ * @param A_inv Output pseudo-inverse [0..n-1][0..m-1]
  */
 void svd_invs(double** A, int n, int m, double* w, double** V, double** A_inv);
+void svd_invs(float** A, int n, int m, float* w, float** V, float** A_inv);
+void svd_invs(long double** A, int n, int m, long double* w, long double** V, long double** A_inv);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,262 @@
+#if !defined(_SVD_FIXED_H)
+#define _SVD_FIXED_H
+
+#include <cmath>
+#include <limits>
+
+#define SVD_FIXED_MAXSWEEP 12   /* sweeps of svd_fixed_jacobi() */
+
+/** One-sided Jacobi orthogonalisation of C vectors of length L, the kernel
+ * of svd_fixed().
+ *
+ * All loop bounds are compile-time constants so that the compiler can unroll
+ * them; nothing is allocated. For C = 2 the first rotation is exact, so the
+ * 2 x 2 case is closed-form (the second sweep only confirms convergence).
+ * If its largest entry is beyond the fourth root of the overflow or
+ * underflow threshold, G is scaled by a power of two to a largest entry of
+ * order 1 first, so that the sums of squares and their squares neither
+ * overflow nor underflow. A vector whose sum of squares underflows all the
+ * same is taken as null.
+ *
+ * @param G Input vectors [0..C-1][0..L-1]; output orthonormal vectors
+ *          (completed to an orthonormal set where w is zero)
+ * @param R Output rotation [0..C-1][0..C-1], G_out = R.G_in / w
+ * @param w Output norms of the orthogonalised vectors, decreasing
+ * @return Number of sweeps, or -1 if the vectors were not orthogonal to
+ *         the working accuracy after SVD_FIXED_MAXSWEEP sweeps
+ */
+template <int C, int L, typename T>
+inline int svd_fixed_jacobi(T (&G)[C][L], T (&R)[C][C], T (&w)[C])
+{
+    const T tol = std::numeric_limits<T>::epsilon() * L;
+    const T small = std::sqrt(std::numeric_limits<T>::min()) / std::numeric_limits<T>::epsilon();
+    const T null = std::numeric_limits<T>::min() / std::numeric_limits<T>::epsilon();
+    T amax = 0;
+    int e = 0;
+    int sweep;
+
+    for (int i = 0; i < C; i++)
+        for (int j = 0; j < C; j++)
+            R[i][j] = (i == j) ? T(1) : T(0);
+
+    for (int j = 0; j < C; j++)
+        for (int i = 0; i < L; i++)
+            amax = (std::abs(G[j][i]) > amax) ? std::abs(G[j][i]) : amax;
+    if (amax > 0 && amax <= std::numeric_limits<T>::max())
+        std::frexp(amax, &e);
+    if (e < std::numeric_limits<T>::min_exponent / 4 + 2 || e > std::numeric_limits<T>::max_exponent / 4 - 2) {
+        for (int j = 0; j < C; j++)
+            for (int i = 0; i < L; i++)
+                G[j][i] = std::ldexp(G[j][i], -e);
+    } else
+        e = 0;
+
+    for (sweep = 0; sweep < SVD_FIXED_MAXSWEEP; sweep++) {
+        bool rotated = false;
+
+        for (int p = 0; p < C - 1; p++)
+            for (int q = p + 1; q < C; q++) {
+                T alpha = 0, beta = 0, gamma = 0;
+
+                for (int i = 0; i < L; i++) {
+                    alpha += G[p][i] * G[p][i];
+                    beta += G[q][i] * G[q][i];
+                    gamma += G[p][i] * G[q][i];
+                }
+                if (alpha < null || beta < null || std::abs(gamma) <= tol * std::sqrt(alpha) * std::sqrt(beta))
+                    continue;
+
+                /*
+                 * t = tan(theta), the smaller root of t^2 + 2.zeta.t - 1 = 0,
+                 * zeta = (beta - alpha) / (2.gamma); d^2 + 4.gamma^2
+                 * underflows for the tiny vectors of a graded G, which take
+                 * the ratio form
+                 */
+                T d = beta - alpha;
+                T t;
+
+                if (alpha < small || beta < small) {
+                    T zeta = d / (2 * gamma);
+
+                    t = std::copysign(T(1), zeta) / (std::abs(zeta) + std::sqrt(1 + zeta * zeta));
+                } else
+                    t = ((d >= 0) ? 2 * gamma : -2 * gamma) / (std::abs(d) + std::sqrt(d * d + 4 * gamma * gamma));
+                T c = 1 / std::sqrt(1 + t * t);
+                T s = c * t;
+
+                for (int i = 0; i < L; i++) {
+                    T x = G[p][i];
+                    T y = G[q][i];
+
+                    G[p][i] = c * x - s * y;
+                    G[q][i] = s * x + c * y;
+                }
+                for (int i = 0; i < C; i++) {
+                    T x = R[p][i];
+                    T y = R[q][i];
+
+                    R[p][i] = c * x - s * y;
+                    R[q][i] = s * x + c * y;
+                }
+                rotated = true;
+            }
+        if (!rotated)
+            break;
+    }
+
+    for (int j = 0; j < C; j++) {
+        T s = 0;
+
+        for (int i = 0; i < L; i++)
+            s += G[j][i] * G[j][i];
+        w[j] = std::sqrt(s);
+    }
+
+    /*
+     * sort in order of decreasing norms
+     */
+    for (int j = 0; j < C - 1; j++) {
+        int jmax = j;
+
+        for (int i = j + 1; i < C; i++)
+            if (w[i] > w[jmax])
+                jmax = i;
+        if (jmax != j) {
+            T tmp = w[j];
+
+            w[j] = w[jmax];
+            w[jmax] = tmp;
+            for (int i = 0; i < L; i++) {
+                tmp = G[j][i];
+                G[j][i] = G[jmax][i];
+                G[jmax][i] = tmp;
+            }
+            for (int i = 0; i < C; i++) {
+                tmp = R[j][i];
+                R[j][i] = R[jmax][i];
+                R[jmax][i] = tmp;
+            }
+        }
+    }
+
+    /*
+     * normalise; null vectors are replaced by the unit vector e_r that keeps
+     * most of its norm after Gram-Schmidt (twice) against the previous
+     * ones, normalised
+     */
+    for (int j = 0; j < C; j++) {
+        T x[L];
+        T best = -1;
+
+        if (w[j] > w[0] * tol && w[j] > std::numeric_limits<T>::min()) {
+            T f = 1 / w[j];
+
+            for (int i = 0; i < L; i++)
+                G[j][i] *= f;
+            continue;
+        }
+        for (int r = 0; r < L; r++) {
+            T s = 0;
+
+            for (int i = 0; i < L; i++)
+                G[j][i] = (i == r) ? T(1) : T(0);
+            for (int pass = 0; pass < 2; pass++)
+                for (int l = 0; l < j; l++) {
+                    T d = 0;
+
+                    for (int i = 0; i < L; i++)
+                        d += G[l][i] * G[j][i];
+                    for (int i = 0; i < L; i++)
+                        G[j][i] -= d * G[l][i];
+                }
+            for (int i = 0; i < L; i++)
+                s += G[j][i] * G[j][i];
+            if (s > best) {
+                best = s;
+                for (int i = 0; i < L; i++)
+                    x[i] = G[j][i];
+            }
+        }
+        best = 1 / std::sqrt(best);
+        for (int i = 0; i < L; i++)
+            G[j][i] = x[i] * best;
+    }
+    if (e != 0)
+        for (int j = 0; j < C; j++)
+            w[j] = std::ldexp(w[j], e);
+
+    return (sweep < SVD_FIXED_MAXSWEEP) ? sweep + 1 : -1;
+}
+
+/* Forms G from A and U, V from the result of svd_fixed_jacobi(), depending
+ * on whether the columns (M >= N) or the rows (M < N) of A are
+ * orthogonalised.
+ */
+template <int M, int N, typename T, bool Tall = (M >= N)>
+struct svd_fixed_impl;
+
+template <int M, int N, typename T>
+struct svd_fixed_impl<M, N, T, true> {
+    static inline int run(T (&A)[M][N], T (&w)[N], T (&V)[N][N])
+    {
+        T G[N][M], R[N][N];
+        int sweeps;
+
+        for (int i = 0; i < M; i++)
+            for (int j = 0; j < N; j++)
+                G[j][i] = A[i][j];
+        sweeps = svd_fixed_jacobi(G, R, w);
+        for (int i = 0; i < M; i++)
+            for (int j = 0; j < N; j++)
+                A[i][j] = G[j][i];
+        for (int i = 0; i < N; i++)
+            for (int j = 0; j < N; j++)
+                V[i][j] = R[j][i];
+        return sweeps;
+    }
+};
+
+template <int M, int N, typename T>
+struct svd_fixed_impl<M, N, T, false> {
+    static inline int run(T (&A)[M][N], T (&w)[M], T (&V)[N][M])
+    {
+        T G[M][N], R[M][M];
+        int sweeps;
+
+        for (int i = 0; i < M; i++)
+            for (int j = 0; j < N; j++)
+                G[i][j] = A[i][j];
+        sweeps = svd_fixed_jacobi(G, R, w);
+        for (int i = 0; i < N; i++)
+            for (int j = 0; j < M; j++)
+                V[i][j] = G[j][i];
+        for (int i = 0; i < M; i++)
+            for (int j = 0; j < M; j++)
+                A[i][j] = R[j][i];
+        return sweeps;
+    }
+};
+
+/** Performs singular value decomposition for a matrix whose dimensions are
+ * known at compile time (e.g. 2x2, 3x3, 4x4), A = U.W.V'.
+ *
+ * Header-only and allocation-free: the decomposition is done by one-sided
+ * Jacobi rotations in local arrays (closed-form for two columns or rows), so
+ * that the call can be inlined into the caller. Unlike svd(), the singular
+ * values are sorted in decreasing order, and U and V are orthogonal also
+ * for rank-deficient A (as needed e.g. by the Kabsch algorithm).
+ *
+ * @param A Input matrix A [0..M-1][0..N-1]; output matrix U [0..M-1][0..K-1],
+ *          K = min(M,N)
+ * @param w Ouput vector [0..K-1] of singular values
+ * @param V Output matrix V [0..N-1][0..K-1] (not transposed)
+ * @return Number of Jacobi sweeps, or -1 if they did not converge in
+ *         SVD_FIXED_MAXSWEEP sweeps (the result is then approximate)
+ */
+template <int M, int N, typename T, int K = (M < N) ? M : N>
+inline int svd_fixed(T (&A)[M][N], T (&w)[K], T (&V)[N][K])
+{
+    return svd_fixed_impl<M, N, T>::run(A, w, V);
+}
+
+#endif
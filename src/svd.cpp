@@ -6,21 +6,89 @@
 #include <string.h>
 #include <limits.h>
 #include <errno.h>
-
-#define SVD_NMAX 40
-#define SVD_EPS 4.0e-15
+#include <float.h>
+#include <limits>
+#include <chrono>
+
+#include "svd.hpp"
+#include "svd_internal.hpp"
+
+#define SVD_NMAX 40             /* QR iterations per singular value, pooled
+                                 * over the sweep */
+#define SVD_NB 32               /* panel width of the blocked reduction */
+#define SVD_NBMIN 128           /* blocked reduction is used while at least
+                                 * that many columns remain */
+#define SVD_CB 256              /* column block of the trailing update */
+#define SVD_KC 128              /* inner block of matmul() */
+#define SVD_MR 4                /* register block of matmul(): rows */
+#define SVD_NR 8                /* register block of matmul(): columns */
+#define SVD_TALL 2              /* QR preprocessing is used for m >= SVD_TALL.n */
+#define SVD_QRB 131072          /* elements in a row block of the tall QR */
+#define SVD_ROTMIN 32           /* the QR sweep rotates transposed copies of U
+                                 * and V from that order on */
+#define SVD_RQ 8                /* QR sweeps of rotations queued at most */
+
+#define SVD_ENGINE_QR 0         /* implicit-shift QR sweep */
+#define SVD_ENGINE_DC 1         /* divide and conquer, bdc() */
+#define SVD_ENGINE_JACOBI 2     /* one-sided Jacobi, jacobi() */
 
 int svd_verbose = 0;
+struct svd_stats* svd_stat = NULL;
+
+static const char* phase_names[SVD_NPHASE] = {
+    "QR reduction",
+    "householder reduction",
+    "accumulating right-hand transformations",
+    "accumulating left-hand transformations",
+    "diagonalization of the bidiagonal form",
+    "back-transformation",
+    "sorting"
+};
+
+static double wtime()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Starts a phase; the clock is only read if the phase is recorded. */
+static double phase_start()
+{
+    return (svd_stat != NULL || svd_verbose) ? wtime() : 0.0;
+}
+
+/* Ends a phase started at t0: adds its time and flops to svd_stat and
+ * reports them if svd_verbose is set. */
+static void phase_end(int phase, double t0, double flops)
+{
+    double t;
+
+    if (svd_stat == NULL && !svd_verbose)
+        return;
+    t = wtime() - t0;
+    if (svd_stat != NULL) {
+        svd_stat->time[phase] += t;
+        svd_stat->flops[phase] += flops;
+    }
+    if (svd_verbose) {
+        fprintf(stderr, "  svd: %s: %.3g s", phase_names[phase], t);
+        if (flops > 0.0)
+            fprintf(stderr, ", %.3g flops", flops);
+        fprintf(stderr, "\n");
+        fflush(stderr);
+    }
+}
 
-typedef struct {
-    double* v;
+template <typename T>
+struct indexedvalue {
+    T* v;
     int i;
-} indexedvalue;
+};
 
+template <typename T>
 static int cmp_iv(const void* p1, const void* p2)
 {
-    double v1 = *((indexedvalue *) p1)->v;
-    double v2 = *((indexedvalue *) p2)->v;
+    T v1 = *((indexedvalue<T> *) p1)->v;
+    T v2 = *((indexedvalue<T> *) p2)->v;
 
     if (v1 > v2)
         return -1;
@@ -29,22 +97,23 @@ static int cmp_iv(const void* p1, const void* p2)
     return 0;
 }
 
-static void sortvector(int n, double* v, int* pos)
+template <typename T>
+static void sortvector(int n, T* v, int* pos)
 {
-    indexedvalue* iv = NULL;
+    indexedvalue<T>* iv = NULL;
     int i;
 
     if (n <= 0)
         return;
 
-    iv = (indexedvalue*)(malloc(n * sizeof(indexedvalue)));
+    iv = (indexedvalue<T>*)(malloc(n * sizeof(indexedvalue<T>)));
 
     for (i = 0; i < n; ++i) {
         iv[i].v = &v[i];
         iv[i].i = i;
     }
 
-    qsort(iv, n, sizeof(indexedvalue), cmp_iv);
+    qsort(iv, n, sizeof(indexedvalue<T>), cmp_iv<T>);
 
     for (i = 0; i < n; ++i)
         pos[i] = iv[i].i;
@@ -52,7 +121,7 @@ static void sortvector(int n, double* v, int* pos)
     free(iv);
 }
 
-static void quit(const char* format, ...)
+void quit(const char* format, ...)
 {
     va_list args;
 
@@ -71,9 +140,10 @@ static void quit(const char* format, ...)
  * [n2][n1].
  * @param n1 Number of columns
  * @param n2 Number of rows
+ * @param unitsize Size of an element
  * @return Matrix
  */
-static void* alloc2d(int n1, int n2, size_t unitsize)
+void* alloc2d(int n1, int n2, size_t unitsize)
 {
     size_t size;
     char* p;
@@ -83,7 +153,7 @@ static void* alloc2d(int n1, int n2, size_t unitsize)
     if (n1 <= 0 || n2 <= 0)
         quit("alloc2d(): invalid size (n1 = %d, n2 = %d)\n", n1, n2);
 
-    size = n1 * n2;
+    size = (size_t) n1 * n2;
     if ((p = (char*)(calloc(size, unitsize))) == NULL)
         quit("alloc2d(): %s\n", strerror(errno));
 
@@ -92,7 +162,7 @@ static void* alloc2d(int n1, int n2, size_t unitsize)
         quit("alloc2d(): %s\n", strerror(errno));
         ;
     for (i = 0; i < n2; i++)
-        pp[i] = &p[i * n1 * unitsize];
+        pp[i] = &p[(size_t) i * n1 * unitsize];
 
     return pp;
 }
@@ -100,7 +170,7 @@ static void* alloc2d(int n1, int n2, size_t unitsize)
 /* Destroys a matrix.
  * @param pp Matrix
  */
-static void free2d(void* pp)
+void free2d(void* pp)
 {
     void* p;
 
@@ -109,44 +179,390 @@ static void free2d(void* pp)
     free(p);
 }
 
-/** Performs singular value decomposition for a dense matrix.
- * Borrowed from EISPACK (1972-1973).
+/* Returns a pseudo-random number in [-1, 1) (xorshift64*). */
+double randu(unsigned long long* state)
+{
+    unsigned long long x = *state;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return (double) ((x * 2685821657736338717ULL) >> 11) * (2.0 / 9007199254740992.0) - 1.0;
+}
+
+/* Returns a standard normal pseudo-random number (Marsaglia's polar
+ * method).
+ */
+double randn(unsigned long long* state)
+{
+    double u, v, s;
+
+    do {
+        u = randu(state);
+        v = randu(state);
+        s = u * u + v * v;
+    } while (s >= 1.0 || s == 0.0);
+    return u * sqrt(-2.0 * log(s) / s);
+}
+
+/* Orthogonalises x against the rows X[0..j-1] by classical Gram-Schmidt,
+ * twice.
+ * @return Norm of x after orthogonalisation
+ */
+double reorth(int n, double* x, double** X, int j)
+{
+    double s;
+    int pass, i, l;
+
+    for (pass = 0; pass < 2; pass++)
+        for (i = 0; i < j; i++) {
+            double c = 0.0;
+
+            for (l = 0; l < n; l++)
+                c += X[i][l] * x[l];
+            for (l = 0; l < n; l++)
+                x[l] -= c * X[i][l];
+        }
+    s = 0.0;
+    for (l = 0; l < n; l++)
+        s += x[l] * x[l];
+    return sqrt(s);
+}
+
+/* Replaces x by a random unit vector orthogonal to the rows X[0..j-1]. Used
+ * to continue an orthonormal basis that has run into rank deficiency.
+ */
+void randvec(int n, double* x, double** X, int j, unsigned long long* state)
+{
+    double nrm;
+    int i;
+
+    do {
+        for (i = 0; i < n; i++)
+            x[i] = randu(state);
+        nrm = reorth(n, x, X, j);
+    } while (nrm == 0.0);
+    for (i = 0; i < n; i++)
+        x[i] /= nrm;
+}
+
+/* Tests whether the block A[i0..i1-1][l0..l1-1] is zero. */
+template <typename T>
+static int iszero(T** A, int i0, int i1, int l0, int l1)
+{
+    int i, l;
+
+    for (i = i0; i < i1; i++)
+        for (l = l0; l < l1; l++)
+            if (A[i][l] != 0.0)
+                return 0;
+    return 1;
+}
+
+/* Adds the product of A[0..SVD_MR-1][l0..l1-1] and B[l0..l1-1][j..j+SVD_NR-1]
+ * to C, accumulating in registers.
+ */
+template <typename T>
+static inline void matmul_kernel(int l0, int l1, T** A, T** B, int j, T** C)
+{
+    T c[SVD_MR][SVD_NR] = { {0.0} };
+    int l, r, t;
+
+    for (l = l0; l < l1; l++) {
+        const T* b = &B[l][j];
+
+        for (r = 0; r < SVD_MR; r++) {
+            T a = A[r][l];
+
+            for (t = 0; t < SVD_NR; t++)
+                c[r][t] += a * b[t];
+        }
+    }
+    for (r = 0; r < SVD_MR; r++)
+        for (t = 0; t < SVD_NR; t++)
+            C[r][j + t] += c[r][t];
+}
+
+/* Computes C = A.B, blocked so that a panel of B stays in cache, with an
+ * SVD_MR x SVD_NR block of C accumulated in registers. Zero blocks of A are
+ * skipped, which pays off for block-structured factors.
+ * @param m Number of rows of A and C
+ * @param n Number of columns of B and C
+ * @param k Number of columns of A and rows of B
+ * @param A Input matrix [0..m-1][0..k-1]
+ * @param B Input matrix [0..k-1][0..n-1]
+ * @param C Output matrix [0..m-1][0..n-1]
+ */
+template <typename T>
+void matmul(int m, int n, int k, T** A, T** B, T** C)
+{
+    int i, j, l, r, i0, j0, l0;
+
+    for (i = 0; i < m; i++)
+        memset(C[i], 0, n * sizeof(T));
+    for (l0 = 0; l0 < k; l0 += SVD_KC) {
+        int l1 = (l0 + SVD_KC < k) ? l0 + SVD_KC : k;
+
+        for (j0 = 0; j0 < n; j0 += SVD_CB) {
+            int j1 = (j0 + SVD_CB < n) ? j0 + SVD_CB : n;
+
+            for (i0 = 0; i0 < m; i0 += SVD_MR) {
+                int i1 = (i0 + SVD_MR < m) ? i0 + SVD_MR : m;
+
+                if (iszero(A, i0, i1, l0, l1))
+                    continue;
+
+                if (i1 - i0 < SVD_MR) {
+                    for (i = i0; i < i1; i++)
+                        for (l = l0; l < l1; l++) {
+                            T a = A[i][l];
+                            T* b = B[l];
+
+                            for (j = j0; j < j1; j++)
+                                C[i][j] += a * b[j];
+                        }
+                    continue;
+                }
+
+                for (j = j0; j + SVD_NR <= j1; j += SVD_NR)
+                    matmul_kernel(l0, l1, &A[i0], B, j, &C[i0]);
+                for (; j < j1; j++)
+                    for (r = 0; r < SVD_MR; r++) {
+                        T c = 0.0;
+
+                        for (l = l0; l < l1; l++)
+                            c += A[i0 + r][l] * B[l][j];
+                        C[i0 + r][j] += c;
+                    }
+            }
+        }
+    }
+}
+
+/* Generates a Householder reflector H = I - tau.v.v' such that H.x = beta.e1.
+ * On exit x[1..n-1] contains v[1..n-1] (v[0] = 1 is implicit).
+ * @param n Length of x
+ * @param x Input vector; output reflector
+ * @param tau Output scalar factor
+ * @param u0 Output first element of the unnormalised reflector x - beta.e1
+ *           (the form the accumulation phases of svd() expect)
+ * @return beta
+ */
+template <typename T>
+T householder(int n, T* x, T* tau, T* u0)
+{
+    T scale = 0.0, s = 0.0, beta;
+    int i;
+
+    for (i = 0; i < n; i++)
+        scale += fabs(x[i]);
+    if (scale == 0.0) {
+        *tau = 0.0;
+        *u0 = 0.0;
+        return 0.0;
+    }
+    for (i = 0; i < n; i++) {
+        T t = x[i] / scale;
+
+        s += t * t;
+    }
+    beta = -copysign(scale * sqrt(s), x[0]);
+    *u0 = x[0] - beta;
+    *tau = -*u0 / beta;
+    for (i = 1; i < n; i++)
+        x[i] /= *u0;
+    x[0] = 1.0;
+
+    return beta;
+}
+
+/* Blocked Householder reduction to upper bidiagonal form (m >= n).
  *
- * The input matrix A is presented as  A = U.W.V'.
+ * Follows LAPACK's dlabrd: SVD_NB reflectors from each side are aggregated
+ * into the compact form A - V.Y' - X.U' so that the trailing matrix is
+ * updated once per panel by matrix-matrix products. The reflectors are left
+ * in A in the same (unnormalised) form as produced by the unblocked loop in
+ * svd(), which then takes over for the last columns.
  *
- * @param A Input matrix A [0..m-1][0..n-1]; output matrix U
+ * @param A Input matrix A [0..m-1][0..n-1]; output reflectors
  * @param n Number of columns
  * @param m Number of rows
- * @param w Ouput vector [0..n-1] that presents diagonal matrix W 
- * @param V output matrix V [0..n-1][0..n-1] (not transposed)
+ * @param w Output diagonal [0..n-1]
+ * @param rv1 Output superdiagonal [0..n-1] (rv1[i] = B[i-1][i])
+ * @param tst1 Output max(|w[i]| + |rv1[i]|) over the reduced columns
+ * @return Number of reduced columns
  */
-void svd(double** A, int n, int m, double* w, double** V)
+template <typename T>
+static int bidiag_blocked(T** A, int n, int m, T* w, T* rv1, T* tst1)
 {
-    double* rv1;
-    int i, j, k, l = -1;
-    double tst1, c, f, g, h, s, scale;
+    T** Vp = (T**)(alloc2d(SVD_NB, m, sizeof(T)));
+    T** Xp = (T**)(alloc2d(SVD_NB, m, sizeof(T)));
+    T** Yt = (T**)(alloc2d(n, SVD_NB, sizeof(T)));
+    T** Ut = (T**)(alloc2d(n, SVD_NB, sizeof(T)));
+    T* x = (T*)(malloc(m * sizeof(T)));
+    T* y = (T*)(malloc(n * sizeof(T)));
+    T t1[SVD_NB], t2[SVD_NB];
+    int p, t, s, r, c, c0;
+
+    rv1[0] = 0.0;
+    *tst1 = 0.0;
+    for (p = 0; n - p > SVD_NBMIN; p += SVD_NB) {
+        int pe = p + SVD_NB;
+
+        for (t = 0; t < SVD_NB; t++) {
+            int j = p + t;
+            T tau, u0, beta;
 
-    assert(m > 0 && n > 0);
+            /*
+             * update column j and annihilate it below the diagonal
+             */
+            for (r = j; r < m; r++) {
+                T a = A[r][j];
 
-    rv1 = (double*)(malloc(n * sizeof(double)));
+                for (s = 0; s < t; s++)
+                    a -= Vp[r][s] * Yt[s][j] + Xp[r][s] * Ut[s][j];
+                x[r - j] = a;
+            }
+            beta = householder(m - j, x, &tau, &u0);
+            w[j] = beta;
+            for (r = j; r < m; r++) {
+                Vp[r][t] = x[r - j];
+                A[r][j] = x[r - j] * u0;
+            }
 
-    /*
-     * householder reduction to bidiagonal form 
-     */
-    if (svd_verbose) {
-        fprintf(stderr, "  svd: householder reduction:");
-        fflush(stderr);
+            /*
+             * Y(:,t) = tau.(A - V.Y' - X.U')'.v
+             */
+            for (c = j + 1; c < n; c++)
+                y[c] = 0.0;
+            for (r = j; r < m; r++) {
+                T vr = Vp[r][t];
+
+                for (c = j + 1; c < n; c++)
+                    y[c] += A[r][c] * vr;
+            }
+            for (s = 0; s < t; s++) {
+                t1[s] = 0.0;
+                t2[s] = 0.0;
+                for (r = j; r < m; r++) {
+                    t1[s] += Vp[r][s] * Vp[r][t];
+                    t2[s] += Xp[r][s] * Vp[r][t];
+                }
+            }
+            for (s = 0; s < t; s++)
+                for (c = j + 1; c < n; c++)
+                    y[c] -= Yt[s][c] * t1[s] + Ut[s][c] * t2[s];
+            for (c = j + 1; c < n; c++)
+                Yt[t][c] = tau * y[c];
+
+            /*
+             * update row j and annihilate it right of the superdiagonal
+             */
+            for (c = j + 1; c < n; c++) {
+                T a = A[j][c];
+
+                for (s = 0; s <= t; s++)
+                    a -= Vp[j][s] * Yt[s][c];
+                for (s = 0; s < t; s++)
+                    a -= Xp[j][s] * Ut[s][c];
+                y[c] = a;
+            }
+            beta = householder(n - j - 1, &y[j + 1], &tau, &u0);
+            rv1[j + 1] = beta;
+            for (c = j + 1; c < n; c++) {
+                Ut[t][c] = y[c];
+                A[j][c] = y[c] * u0;
+            }
+
+            /*
+             * X(:,t) = tau.(A - V.Y' - X.U').u
+             */
+            for (s = 0; s <= t; s++) {
+                t1[s] = 0.0;
+                for (c = j + 1; c < n; c++)
+                    t1[s] += Yt[s][c] * Ut[t][c];
+            }
+            for (s = 0; s < t; s++) {
+                t2[s] = 0.0;
+                for (c = j + 1; c < n; c++)
+                    t2[s] += Ut[s][c] * Ut[t][c];
+            }
+            for (r = j + 1; r < m; r++) {
+                T a = 0.0;
+
+                for (c = j + 1; c < n; c++)
+                    a += A[r][c] * Ut[t][c];
+                for (s = 0; s <= t; s++)
+                    a -= Vp[r][s] * t1[s];
+                for (s = 0; s < t; s++)
+                    a -= Xp[r][s] * t2[s];
+                Xp[r][t] = tau * a;
+            }
+
+            {
+                T tmp = fabs(w[j]) + fabs(rv1[j]);
+
+                *tst1 = (*tst1 > tmp) ? *tst1 : tmp;
+            }
+        }
+
+        /*
+         * trailing update A -= V.Y' + X.U', by column blocks to keep the
+         * panel factors in cache
+         */
+        for (c0 = pe; c0 < n; c0 += SVD_CB) {
+            int c1 = (c0 + SVD_CB < n) ? c0 + SVD_CB : n;
+
+            for (r = pe; r < m; r++) {
+                T* a = A[r];
+
+                for (s = 0; s < SVD_NB; s++) {
+                    T vs = Vp[r][s];
+                    T xs = Xp[r][s];
+                    T* ys = Yt[s];
+                    T* us = Ut[s];
+
+                    for (c = c0; c < c1; c++)
+                        a[c] -= vs * ys[c] + xs * us[c];
+                }
+            }
+        }
     }
+
+    free2d(Vp);
+    free2d(Xp);
+    free2d(Yt);
+    free2d(Ut);
+    free(x);
+    free(y);
+
+    return p;
+}
+
+/* Householder reduction to upper bidiagonal form.
+ * @param A Input matrix A [0..m-1][0..n-1]; output reflectors
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Output diagonal [0..n-1]
+ * @param rv1 Output superdiagonal [0..n-1] (rv1[i] = B[i-1][i])
+ * @return max(|w[i]| + |rv1[i]|), the scale of the convergence tests
+ */
+template <typename T>
+static T bidiag(T** A, int n, int m, T* w, T* rv1)
+{
+    int i, i0 = 0, j, k, l;
+    T tst1, f, g, h, s, scale;
+
     g = 0.0;
     scale = 0.0;
     tst1 = 0.0;
-    for (i = 0; i < n; i++) {
-
-        if (svd_verbose > 1) {
-            fprintf(stderr, ".");
-            fflush(stderr);
-        }
-
+    if (m >= n && n > SVD_NBMIN) {
+        i0 = bidiag_blocked(A, n, m, w, rv1, &tst1);
+        g = rv1[i0];
+        scale = 1.0;
+    }
+    for (i = i0; i < n; i++) {
         l = i + 1;
         rv1[i] = scale * g;
         g = 0.0;
@@ -208,31 +624,33 @@ void svd(double** A, int n, int m, double* w, double** V)
             }
         }
         {
-            double tmp = fabs(w[i]) + fabs(rv1[i]);
+            T tmp = fabs(w[i]) + fabs(rv1[i]);
 
             tst1 = (tst1 > tmp) ? tst1 : tmp;
         }
     }
 
-    /*
-     * accumulation of right-hand transformations 
-     */
-    if (svd_verbose) {
-        fprintf(stderr, "\n  svd: accumulating right-hand transformations:");
-        fflush(stderr);
-    }
-    for (i = n - 1; i >= 0; i--) {
+    return tst1;
+}
 
-        if (svd_verbose > 1) {
-            fprintf(stderr, ".");
-            fflush(stderr);
-        }
+/* Accumulation of right-hand transformations.
+ * @param A Input reflectors from bidiag() [0..m-1][0..n-1]
+ * @param n Number of columns
+ * @param rv1 Input superdiagonal from bidiag()
+ * @param V Output matrix V [0..n-1][0..n-1]
+ */
+template <typename T>
+static void accum_right(T** A, int n, T* rv1, T** V)
+{
+    int i, j, k, l = n;
+    T g = 0.0, s;
 
+    for (i = n - 1; i >= 0; i--) {
         if (i < n - 1) {        /* no test in NR */
             if (g != 0.0) {
                 for (j = l; j < n; j++)
                     /*
-                     * double division avoids possible underflow 
+                     * T division avoids possible underflow 
                      */
                     V[j][i] = (A[i][j] / A[i][l]) / g;
                 for (j = l; j < n; j++) {
@@ -252,21 +670,21 @@ void svd(double** A, int n, int m, double* w, double** V)
         g = rv1[i];
         l = i;
     }
+}
 
-    /*
-     * accumulation of left-hand transformations 
-     */
-    if (svd_verbose) {
-        fprintf(stderr, "\n  svd: accumulating left-hand transformations:");
-        fflush(stderr);
-    }
-    for (i = (m < n) ? m - 1 : n - 1; i >= 0; i--) {
-
-        if (svd_verbose > 1) {
-            fprintf(stderr, ".");
-            fflush(stderr);
-        }
+/* Accumulation of left-hand transformations.
+ * @param A Input reflectors from bidiag(); output matrix U [0..m-1][0..n-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Input diagonal from bidiag()
+ */
+template <typename T>
+static void accum_left(T** A, int n, int m, T* w)
+{
+    int i, j, k, l;
+    T f, g, s;
 
+    for (i = (m < n) ? m - 1 : n - 1; i >= 0; i--) {
         l = i + 1;
         g = w[i];
         if (i != n - 1)
@@ -278,7 +696,7 @@ void svd(double** A, int n, int m, double* w, double** V)
                 for (k = l; k < m; k++)
                     s += A[k][i] * A[k][j];
                 /*
-                 * double division avoids possible underflow
+                 * T division avoids possible underflow
                  */
                 f = (s / A[i][i]) / g;
                 for (k = i; k < m; k++)
@@ -291,34 +709,230 @@ void svd(double** A, int n, int m, double* w, double** V)
                 A[j][i] = 0.0;
         A[i][i] += 1.0;
     }
+}
+
+/* Rotations of the columns of U or V in the QR sweep. From order SVD_ROTMIN
+ * on, the matrix is copied transposed, in the panels of rot_seq(), for the
+ * duration of the sweep, and the rotations are queued and applied together
+ * once the queue holds SVD_RQ sweeps' worth; below, they are applied in
+ * place at once.
+ *
+ * Before being applied, the queued rotations are reordered into waves:
+ * each one is given the earliest level after those of the previous
+ * rotations on the same columns, and they are sorted by level. Rotations of
+ * a level touch distinct columns, and successive QR steps interleave, step
+ * s at position i being at level i + 2s, so that only a few columns are
+ * live at a time and each is loaded once per flush.
+ */
+template <typename T>
+struct rotqueue {
+    T** X;                      /* matrix [0..nr-1][0..n-1], or NULL */
+    T* P;                       /* transposed copy in panels, or NULL */
+    int n;
+    int nr;
+    int nthreads;
+    givens<T>* g;               /* queued rotations */
+    int nq;
+    int cap;
+    givens<T>* gw;              /* workspace of the reordering */
+    int* lev;
+    int* cnt;
+    int* clev;                  /* level of the last rotation of each column */
+};
+
+#define PIDX(i, j, n) ((((size_t) (j) / SVD_RCB) * (n) + (i)) * SVD_RCB + (j) % SVD_RCB)
+
+template <typename T>
+static void rq_init(rotqueue<T>* rq, T** X, int n, int nr, int nthreads)
+{
+    size_t np = (size_t) (nr + SVD_RCB - 1) / SVD_RCB;
+    int i, j;
+
+    rq->X = X;
+    rq->P = NULL;
+    rq->n = n;
+    rq->nr = nr;
+    rq->nthreads = nthreads;
+    rq->g = rq->gw = NULL;
+    rq->lev = rq->cnt = rq->clev = NULL;
+    rq->nq = 0;
+    rq->cap = 0;
+    if (X == NULL || n < SVD_ROTMIN)
+        return;
+
+    rq->cap = SVD_RQ * n;
+    rq->P = (T*)(calloc(np * n * SVD_RCB, sizeof(T)));
+    rq->g = (givens<T>*)(malloc(rq->cap * sizeof(givens<T>)));
+    rq->gw = (givens<T>*)(malloc(rq->cap * sizeof(givens<T>)));
+    rq->lev = (int*)(malloc(rq->cap * sizeof(int)));
+    rq->cnt = (int*)(malloc((rq->cap + 1) * sizeof(int)));
+    rq->clev = (int*)(malloc(n * sizeof(int)));
+    if (rq->P == NULL || rq->g == NULL || rq->gw == NULL || rq->lev == NULL || rq->cnt == NULL || rq->clev == NULL)
+        quit("svd(): could not allocate rotation workspace\n");
+    for (j = 0; j < nr; j++)
+        for (i = 0; i < n; i++)
+            rq->P[PIDX(i, j, n)] = X[j][i];
+}
+
+template <typename T>
+static void rq_flush(rotqueue<T>* rq)
+{
+    givens<T>* tmp;
+    int nlev = 0;
+    int t;
+
+    if (rq->nq == 0)
+        return;
 
     /*
-     * diagonalization of the bidiagonal form
+     * levels, then a counting sort by level (stable, so that the order of
+     * rotations sharing a column is kept)
      */
-    if (svd_verbose) {
-        fprintf(stderr, "\n  svd: diagonalization of the bidiagonal form:");
-        fflush(stderr);
+    memset(rq->clev, 0, rq->n * sizeof(int));
+    for (t = 0; t < rq->nq; t++) {
+        int p = rq->g[t].p;
+        int q = rq->g[t].q;
+        int l = rq->clev[p];
+
+        if (q >= 0 && rq->clev[q] > l)
+            l = rq->clev[q];
+        rq->lev[t] = l;
+        rq->clev[p] = l + 1;
+        if (q >= 0)
+            rq->clev[q] = l + 1;
+        if (l + 1 > nlev)
+            nlev = l + 1;
+    }
+    memset(rq->cnt, 0, (nlev + 1) * sizeof(int));
+    for (t = 0; t < rq->nq; t++)
+        rq->cnt[rq->lev[t] + 1]++;
+    for (t = 0; t < nlev; t++)
+        rq->cnt[t + 1] += rq->cnt[t];
+    for (t = 0; t < rq->nq; t++)
+        rq->gw[rq->cnt[rq->lev[t]]++] = rq->g[t];
+    tmp = rq->g;
+    rq->g = rq->gw;
+    rq->gw = tmp;
+
+    rot_seq(rq->nq, rq->g, rq->n, rq->nr, rq->P, rq->nthreads);
+    rq->nq = 0;
+}
+
+/* Rotates the columns p and q, x_p = c.x_p + s.x_q, x_q = c.x_q - s.x_p;
+ * q < 0 negates the column p.
+ */
+template <typename T>
+static inline void rq_push(rotqueue<T>* rq, int p, int q, T c, T s)
+{
+    T** X = rq->X;
+    int j;
+
+    if (X == NULL)
+        return;
+    if (rq->P != NULL) {
+        givens<T>* g = &rq->g[rq->nq++];
+
+        g->p = p;
+        g->q = q;
+        g->c = c;
+        g->s = s;
+        if (rq->nq == rq->cap)
+            rq_flush(rq);
+        return;
     }
+    if (q < 0) {
+        for (j = 0; j < rq->nr; j++)
+            X[j][p] = -X[j][p];
+        return;
+    }
+    for (j = 0; j < rq->nr; j++) {
+        T y = X[j][p];
+        T z = X[j][q];
+
+        X[j][p] = y * c + z * s;
+        X[j][q] = z * c - y * s;
+    }
+}
+
+/* Applies the pending rotations and copies the matrix back. */
+template <typename T>
+static void rq_done(rotqueue<T>* rq)
+{
+    int n = rq->n;
+    int i, j;
+
+    if (rq->P == NULL)
+        return;
+    rq_flush(rq);
+    for (j = 0; j < rq->nr; j++)
+        for (i = 0; i < n; i++)
+            rq->X[j][i] = rq->P[PIDX(i, j, n)];
+    free(rq->P);
+    free(rq->g);
+    free(rq->gw);
+    free(rq->lev);
+    free(rq->cnt);
+    free(rq->clev);
+}
+
+/* Diagonalization of the bidiagonal form by implicit-shift QR.
+ *
+ * The rotations are applied to the columns of U and V; either may be NULL,
+ * in which case only the singular values are computed. From order
+ * SVD_ROTMIN on, U and V are transposed for the duration of the sweep and
+ * the rotations of several QR steps are applied together, block by block,
+ * so that they update contiguous rows held in cache rather than walking two
+ * columns of row-pointer storage per rotation (see rotqueue); smaller
+ * problems, such as the leaves of bdc() and the members of svd_batched(),
+ * are rotated in place and allocate nothing.
+ *
+ * @param n Order of the bidiagonal matrix
+ * @param w Input diagonal; output singular values [0..n-1]
+ * @param rv1 Input superdiagonal (rv1[i] = B[i-1][i]); destroyed
+ * @param tst1 Scale of the convergence tests
+ * @param U Input-output matrix U [0..m-1][0..n-1] or NULL
+ * @param m Number of rows of U
+ * @param V Input-output matrix V [0..nv-1][0..n-1] or NULL
+ * @param nv Number of rows of V
+ * @param nthreads Number of threads applying the rotations; 0 for the
+ *                 OpenMP default
+ * @param st Statistics to add the counters and flops of the sweep to, or
+ *           NULL
+ * @return Flops of the sweep (estimate)
+ */
+template <typename T>
+static double qr_sweep(int n, T* w, T* rv1, T tst1, T** U, int m, T** V, int nv, int nthreads, struct svd_stats* st)
+{
+    rotqueue<T> ru, rv;
+    int its = 0;
+    long nstep = 0, nrotu = 0, nrotv = 0, ncancel = 0, nsplit = 0;
+    int itsmax = 0, lsplit = 0;
+    int i, k, l;
+    T c, f, g, h, s;
+
+    rq_init(&ru, U, n, m, nthreads);
+    rq_init(&rv, V, n, nv, nthreads);
+
     for (k = n - 1; k >= 0; k--) {
         int k1 = k - 1;
-        int its = 0;
-
-        if (svd_verbose > 1) {
-            fprintf(stderr, ".");
-            fflush(stderr);
-        }
+        int itsk = 0;
 
         while (1) {
             int docancellation = 1;
-            double x, y, z;
+            T x, y, z;
             int l1 = -1;
 
+            /*
+             * the limit is on the whole sweep (as in LAPACK's dbdsqr): the
+             * smallest singular values of graded matrices may take many
+             * more steps than the rest once the shift is lost in rounding
+             */
             its++;
-            if (its > SVD_NMAX)
-                quit("svd(): no convergence in %d iterations\n", SVD_NMAX);
+            if (its > SVD_NMAX * n)
+                quit("svd(): no convergence in %d iterations\n", SVD_NMAX * n);
 
             for (l = k; l >= 0; l--) {  /* test for splitting */
-                double tst2 = fabs(rv1[l]) + tst1;
+                T tst2 = fabs(rv1[l]) + tst1;
 
                 if (tst2 == tst1) {
                     docancellation = 0;
@@ -337,6 +951,7 @@ void svd(double** A, int n, int m, double* w, double** V)
              * cancellation of rv1[l] if l > 1
              */
             if (docancellation) {
+                ncancel++;
                 c = 0.0;
                 s = 1.0;
                 for (i = l; i <= k; i++) {
@@ -349,13 +964,8 @@ void svd(double** A, int n, int m, double* w, double** V)
                     w[i] = h;
                     c = g / h;
                     s = -f / h;
-                    for (j = 0; j < m; j++) {
-                        double y = A[j][l1];
-                        double z = A[j][i];
-
-                        A[j][l1] = y * c + z * s;
-                        A[j][i] = z * c - y * s;
-                    }
+                    rq_push(&ru, l1, i, c, s);
+                    nrotu++;
                 }
             }
             /*
@@ -365,6 +975,12 @@ void svd(double** A, int n, int m, double* w, double** V)
             if (l != k) {
                 int i1;
 
+                itsk++;
+                if (l > 0 && l != lsplit)
+                    nsplit++;
+                lsplit = l;
+                nrotu += k - l;
+                nrotv += k - l;
                 /*
                  * shift from bottom 2 by 2 minor
                  */
@@ -394,12 +1010,7 @@ void svd(double** A, int n, int m, double* w, double** V)
                     g = g * c - x * s;
                     h = y * s;
                     y *= c;
-                    for (j = 0; j < n; j++) {
-                        x = V[j][i1];
-                        z = V[j][i];
-                        V[j][i1] = x * c + z * s;
-                        V[j][i] = z * c - x * s;
-                    }
+                    rq_push(&rv, i1, i, c, s);
                     z = hypot(f, h);
                     w[i1] = z;
                     /*
@@ -411,12 +1022,7 @@ void svd(double** A, int n, int m, double* w, double** V)
                     }
                     f = c * g + s * y;
                     x = c * y - s * g;
-                    for (j = 0; j < m; j++) {
-                        y = A[j][i1];
-                        z = A[j][i];
-                        A[j][i1] = y * c + z * s;
-                        A[j][i] = z * c - y * s;
-                    }
+                    rq_push(&ru, i1, i, c, s);
                 }
                 rv1[l] = 0.0;
                 rv1[k] = f;
@@ -427,60 +1033,743 @@ void svd(double** A, int n, int m, double* w, double** V)
                  */
                 if (z < 0.0) {
                     w[k] = -z;
-                    for (j = 0; j < n; j++)
-                        V[j][k] = -V[j][k];
+                    rq_push(&rv, k, -1, T(0), T(0));
                 }
                 break;
             }
         }
+        nstep += itsk;
+        itsmax = (itsk > itsmax) ? itsk : itsmax;
     }
 
-    if (svd_verbose) {
-        fprintf(stderr, "\n");
-        fflush(stderr);
+    rq_done(&ru);
+    rq_done(&rv);
+
+    if (st != NULL) {
+        st->nsv += n;
+        st->its += nstep;
+        st->itsmax = (itsmax > st->itsmax) ? itsmax : st->itsmax;
+        st->splits += nsplit;
+        st->cancellations += ncancel;
     }
 
-    free(rv1);
+    /*
+     * a rotation costs about 15 flops on the bidiagonal form and 6 per row
+     * of U or V that it is applied to
+     */
+    return 15.0 * (nrotu + nrotv) + 6.0 * ((U != NULL) ? (double) nrotu * m : 0.0) + 6.0 * ((V != NULL) ? (double) nrotv * nv : 0.0);
 }
 
-/** Performs sorting of SVD results in order of decreasing singular values.
+/* qr_sweep() without statistics, for the other solvers. */
+template <typename T>
+void bidiag_qr(int n, T* w, T* rv1, T tst1, T** U, int m, T** V, int nv, int nthreads)
+{
+    qr_sweep(n, w, rv1, tst1, U, m, V, nv, nthreads, (struct svd_stats*) NULL);
+}
+
+template <typename T>
+static void svd_run(T** A, int n, int m, T* w, T** V, int engine, int nthreads);
+
+/* Householder QR of a tall matrix by row blocks.
  *
- * @param A Input-output matrix U [0..m-1][0..n-1]
+ * The first block of b rows is factorised in place; every following block
+ * is annihilated against the current R (a flat-tree TSQR), so that each step
+ * works on a cache-sized block only. The reflectors are left in the blocks
+ * and their scalar factors in tau.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]; output reflectors
  * @param n Number of columns
  * @param m Number of rows
- * @param w Input-ouput vector [0..n-1] that presents diagonal matrix W 
- * @param V Input-output matrix V [0..n-1][0..n-1] (not transposed)
+ * @param b Number of rows in a block (n <= b <= m)
+ * @param tau Output scalar factors [0..nblocks-1][0..n-1]
+ * @param R Output triangular factor [0..n-1][0..n-1]
+ */
+template <typename T>
+static void qr_tall(T** A, int n, int m, int b, T** tau, T** R)
+{
+    T* x = (T*)(malloc((b + 1) * sizeof(T)));
+    T* s = (T*)(malloc(n * sizeof(T)));
+    int i, j, k, r, r0;
+
+    for (i = 0; i < n; i++) {
+        T t, u0;
+
+        for (r = i; r < b; r++)
+            x[r - i] = A[r][i];
+        A[i][i] = householder(b - i, x, &tau[0][i], &u0);
+        for (r = i + 1; r < b; r++)
+            A[r][i] = x[r - i];
+        if ((t = tau[0][i]) == 0.0)
+            continue;
+        for (j = i + 1; j < n; j++)
+            s[j] = 0.0;
+        for (r = i; r < b; r++) {
+            T v = x[r - i];
+
+            for (j = i + 1; j < n; j++)
+                s[j] += v * A[r][j];
+        }
+        for (r = i; r < b; r++) {
+            T v = t * x[r - i];
+
+            for (j = i + 1; j < n; j++)
+                A[r][j] -= v * s[j];
+        }
+    }
+    for (i = 0; i < n; i++)
+        for (j = 0; j < n; j++)
+            R[i][j] = (j >= i) ? A[i][j] : 0.0;
+
+    for (k = 1, r0 = b; r0 < m; k++, r0 += b) {
+        int nr = (m - r0 < b) ? m - r0 : b;
+
+        for (i = 0; i < n; i++) {
+            T t, u0;
+
+            x[0] = R[i][i];
+            for (r = 0; r < nr; r++)
+                x[r + 1] = A[r0 + r][i];
+            R[i][i] = householder(nr + 1, x, &tau[k][i], &u0);
+            for (r = 0; r < nr; r++)
+                A[r0 + r][i] = x[r + 1];
+            if ((t = tau[k][i]) == 0.0)
+                continue;
+            for (j = i + 1; j < n; j++)
+                s[j] = R[i][j];
+            for (r = 0; r < nr; r++) {
+                T v = x[r + 1];
+
+                for (j = i + 1; j < n; j++)
+                    s[j] += v * A[r0 + r][j];
+            }
+            for (j = i + 1; j < n; j++)
+                R[i][j] -= t * s[j];
+            for (r = 0; r < nr; r++) {
+                T v = t * x[r + 1];
+
+                for (j = i + 1; j < n; j++)
+                    A[r0 + r][j] -= v * s[j];
+            }
+        }
+    }
+
+    free(x);
+    free(s);
+}
+
+/* Forms U = Q.[X; 0] from the factorisation computed by qr_tall().
  *
- * This function does the work but has downside that it requires temporal 
- * storage equal to the main storage. This may be  a problem for some large
- * applications, but one does not usually use dense SVD in such cases.
+ * The blocks are processed in reverse order; each one is overwritten by its
+ * rows of U as soon as its reflectors have been applied.
+ *
+ * @param A Input reflectors [0..m-1][0..n-1]; output matrix U
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param b Number of rows in a block
+ * @param tau Input scalar factors [0..nblocks-1][0..n-1]
+ * @param X Input matrix [0..n-1][0..n-1]; destroyed
  */
-void svd_sort(double** A, int n, int m, double* w, double** V)
+template <typename T>
+static void qr_tall_apply(T** A, int n, int m, int b, T** tau, T** X)
 {
-    int* pos = (int*)(malloc(n * sizeof(int)));
-    double* wold = (double*)(malloc(n * sizeof(double)));
-    double** aold = (double**)(alloc2d(n, m, sizeof(double)));
-    double** vold = (double**)(alloc2d(n, n, sizeof(double)));
-    double wmax;
-    int i, j;
+    T** Y = (T**)(alloc2d(n, b, sizeof(T)));
+    T* s = (T*)(malloc(n * sizeof(T)));
+    int i, j, k, r, r0;
+
+    for (k = (m - 1) / b; k >= 1; k--) {
+        int nr;
+
+        r0 = k * b;
+        nr = (m - r0 < b) ? m - r0 : b;
+        memset(&Y[0][0], 0, nr * n * sizeof(T));
+        for (i = n - 1; i >= 0; i--) {
+            T t = tau[k][i];
+
+            if (t == 0.0)
+                continue;
+            for (j = 0; j < n; j++)
+                s[j] = X[i][j];
+            for (r = 0; r < nr; r++) {
+                T v = A[r0 + r][i];
+
+                for (j = 0; j < n; j++)
+                    s[j] += v * Y[r][j];
+            }
+            for (j = 0; j < n; j++)
+                X[i][j] -= t * s[j];
+            for (r = 0; r < nr; r++) {
+                T v = t * A[r0 + r][i];
 
-    if (svd_verbose) {
-        fprintf(stderr, "  svd: sorting:");
-        fflush(stderr);
+                for (j = 0; j < n; j++)
+                    Y[r][j] -= v * s[j];
+            }
+        }
+        for (r = 0; r < nr; r++)
+            memcpy(A[r0 + r], Y[r], n * sizeof(T));
+    }
+
+    memset(&Y[0][0], 0, b * n * sizeof(T));
+    for (i = 0; i < n; i++)
+        memcpy(Y[i], X[i], n * sizeof(T));
+    for (i = n - 1; i >= 0; i--) {
+        T t = tau[0][i];
+
+        if (t == 0.0)
+            continue;
+        for (j = 0; j < n; j++)
+            s[j] = Y[i][j];
+        for (r = i + 1; r < b; r++) {
+            T v = A[r][i];
+
+            for (j = 0; j < n; j++)
+                s[j] += v * Y[r][j];
+        }
+        for (j = 0; j < n; j++)
+            Y[i][j] -= t * s[j];
+        for (r = i + 1; r < b; r++) {
+            T v = t * A[r][i];
+
+            for (j = 0; j < n; j++)
+                Y[r][j] -= v * s[j];
+        }
     }
+    for (r = 0; r < b; r++)
+        memcpy(A[r], Y[r], n * sizeof(T));
+
+    free2d(Y);
+    free(s);
+}
+
+/* Economy SVD of a tall matrix (Chan's algorithm): A = Q.R, R = U_R.W.V',
+ * U = Q.U_R. The QR sweep then rotates n-vectors instead of m-vectors.
+ * @param A Input matrix A [0..m-1][0..n-1]; output matrix U (destroyed if
+ *          V is NULL)
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Ouput vector [0..n-1]
+ * @param V Output matrix V [0..n-1][0..n-1] or NULL for singular values only
+ * @param engine Solver for the bidiagonal form (SVD_ENGINE_*)
+ * @param nthreads Number of threads of the QR sweep (see bidiag_qr())
+ */
+template <typename T>
+static void svd_tall(T** A, int n, int m, T* w, T** V, int engine, int nthreads)
+{
+    int b = SVD_QRB / n;
+    double dm = m, dn = n;
+    double t0;
+    T** tau;
+    T** R;
+
+    if (b < n)
+        b = n;
+    if (b > m)
+        b = m;
+    tau = (T**)(alloc2d(n, (m + b - 1) / b, sizeof(T)));
+    R = (T**)(alloc2d(n, n, sizeof(T)));
+
+    t0 = phase_start();
+    qr_tall(A, n, m, b, tau, R);
+    phase_end(SVD_PHASE_QR, t0, 2.0 * dn * dn * (dm - dn / 3.0));
+    svd_run(R, n, n, w, V, engine, nthreads);
+    if (V != NULL) {
+        t0 = phase_start();
+        qr_tall_apply(A, n, m, b, tau, R);
+        phase_end(SVD_PHASE_BACK, t0, 4.0 * dm * dn * dn - 2.0 * dn * dn * dn);
+    }
+
+    free2d(R);
+    free2d(tau);
+}
+
+/* Householder LQ factorisation of a wide matrix, A = [L 0].Q, by column
+ * blocks. This is qr_tall() applied to A' along the (contiguous) rows of A,
+ * without forming A': the first block of b columns is factorised in place
+ * and every following block is annihilated against the current L.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]; output reflectors (in rows)
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param b Number of columns in a block (m <= b <= n)
+ * @param tau Output scalar factors [0..nblocks-1][0..m-1]
+ * @param L Output lower triangular factor [0..m-1][0..m-1]
+ */
+template <typename T>
+static void lq_wide(T** A, int n, int m, int b, T** tau, T** L)
+{
+    T* x = (T*)(malloc((b + 1) * sizeof(T)));
+    int i, k, r, c, c0;
+
+    for (i = 0; i < m; i++) {
+        T* v = A[i];
+        T t, u0;
+
+        v[i] = householder(b - i, &v[i], &tau[0][i], &u0);
+        if ((t = tau[0][i]) == 0.0)
+            continue;
+        for (r = i + 1; r < m; r++) {
+            T* a = A[r];
+            T s = a[i];
+
+            for (c = i + 1; c < b; c++)
+                s += a[c] * v[c];
+            s *= t;
+            a[i] -= s;
+            for (c = i + 1; c < b; c++)
+                a[c] -= s * v[c];
+        }
+    }
+    for (r = 0; r < m; r++)
+        for (c = 0; c < m; c++)
+            L[r][c] = (c <= r) ? A[r][c] : 0.0;
+
+    for (k = 1, c0 = b; c0 < n; k++, c0 += b) {
+        int nc = (n - c0 < b) ? n - c0 : b;
+
+        for (i = 0; i < m; i++) {
+            T* v = &A[i][c0];
+            T t, u0;
+
+            x[0] = L[i][i];
+            memcpy(&x[1], v, nc * sizeof(T));
+            L[i][i] = householder(nc + 1, x, &tau[k][i], &u0);
+            memcpy(v, &x[1], nc * sizeof(T));
+            if ((t = tau[k][i]) == 0.0)
+                continue;
+            for (r = i + 1; r < m; r++) {
+                T* a = &A[r][c0];
+                T s = L[r][i];
+
+                for (c = 0; c < nc; c++)
+                    s += a[c] * v[c];
+                s *= t;
+                L[r][i] -= s;
+                for (c = 0; c < nc; c++)
+                    a[c] -= s * v[c];
+            }
+        }
+    }
+
+    free(x);
+}
+
+/* Forms V = Q'.[X; 0] from the factorisation computed by lq_wide().
+ * @param A Input reflectors [0..m-1][0..n-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param b Number of columns in a block
+ * @param tau Input scalar factors [0..nblocks-1][0..m-1]
+ * @param X Input matrix [0..m-1][0..m-1]; destroyed
+ * @param V Output matrix [0..n-1][0..m-1]
+ */
+template <typename T>
+static void lq_wide_apply(T** A, int n, int m, int b, T** tau, T** X, T** V)
+{
+    T* s = (T*)(malloc(m * sizeof(T)));
+    int i, j, k, c, c0;
+
+    for (k = (n - 1) / b; k >= 1; k--) {
+        int nc;
+
+        c0 = k * b;
+        nc = (n - c0 < b) ? n - c0 : b;
+        for (c = c0; c < c0 + nc; c++)
+            memset(V[c], 0, m * sizeof(T));
+        for (i = m - 1; i >= 0; i--) {
+            T* v = &A[i][c0];
+            T t = tau[k][i];
+
+            if (t == 0.0)
+                continue;
+            memcpy(s, X[i], m * sizeof(T));
+            for (c = 0; c < nc; c++)
+                for (j = 0; j < m; j++)
+                    s[j] += v[c] * V[c0 + c][j];
+            for (j = 0; j < m; j++)
+                X[i][j] -= t * s[j];
+            for (c = 0; c < nc; c++) {
+                T tv = t * v[c];
+
+                for (j = 0; j < m; j++)
+                    V[c0 + c][j] -= tv * s[j];
+            }
+        }
+    }
+
+    for (c = 0; c < b; c++) {
+        if (c < m)
+            memcpy(V[c], X[c], m * sizeof(T));
+        else
+            memset(V[c], 0, m * sizeof(T));
+    }
+    for (i = m - 1; i >= 0; i--) {
+        T* v = A[i];
+        T t = tau[0][i];
+
+        if (t == 0.0)
+            continue;
+        memcpy(s, V[i], m * sizeof(T));
+        for (c = i + 1; c < b; c++)
+            for (j = 0; j < m; j++)
+                s[j] += v[c] * V[c][j];
+        for (j = 0; j < m; j++)
+            V[i][j] -= t * s[j];
+        for (c = i + 1; c < b; c++) {
+            T tv = t * v[c];
+
+            for (j = 0; j < m; j++)
+                V[c][j] -= tv * s[j];
+        }
+    }
+
+    free(s);
+}
+
+/* SVD of a wide matrix: A = [L 0].Q, L = U.W.V_L', V = Q'.V_L. Only the
+ * min(m,n) = m singular triplets are formed.
+ * @param A Input matrix A [0..m-1][0..n-1]; output matrix U [0..m-1][0..m-1]
+ *          (destroyed if V is NULL)
+ * @param n Number of columns
+ * @param m Number of rows (m < n)
+ * @param w Ouput vector [0..m-1]
+ * @param V Output matrix V [0..n-1][0..m-1] or NULL for singular values only
+ * @param engine Solver for the bidiagonal form (SVD_ENGINE_*)
+ * @param nthreads Number of threads of the QR sweep (see bidiag_qr())
+ */
+template <typename T>
+static void svd_wide(T** A, int n, int m, T* w, T** V, int engine, int nthreads)
+{
+    int b = SVD_QRB / m;
+    double dm = m, dn = n;
+    double t0;
+    T** tau;
+    T** L;
+
+    if (b < m)
+        b = m;
+    if (b > n)
+        b = n;
+    tau = (T**)(alloc2d(m, (n + b - 1) / b, sizeof(T)));
+    L = (T**)(alloc2d(m, m, sizeof(T)));
+
+    t0 = phase_start();
+    lq_wide(A, n, m, b, tau, L);
+    phase_end(SVD_PHASE_QR, t0, 2.0 * dm * dm * (dn - dm / 3.0));
+    if (V == NULL)
+        svd_run(L, m, m, w, (T**) NULL, engine, nthreads);
+    else {
+        T** VL = (T**)(alloc2d(m, m, sizeof(T)));
+        int r;
+
+        svd_run(L, m, m, w, VL, engine, nthreads);
+        t0 = phase_start();
+        lq_wide_apply(A, n, m, b, tau, VL, V);
+        phase_end(SVD_PHASE_BACK, t0, 4.0 * dn * dm * dm - 2.0 * dm * dm * dm);
+        for (r = 0; r < m; r++)
+            memcpy(A[r], L[r], m * sizeof(T));
+        free2d(VL);
+    }
+
+    free2d(L);
+    free2d(tau);
+}
+
+/* Multiplies A := A.B in place, a block of rows at a time.
+ * @param A Input-output matrix [0..m-1][0..n-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param B Input matrix [0..n-1][0..n-1]
+ */
+template <typename T>
+static void matmul_right(T** A, int n, int m, T** B)
+{
+    int rb = (m < SVD_NB) ? m : SVD_NB;
+    T** X = (T**)(alloc2d(n, rb, sizeof(T)));
+    int r0, r;
+
+    for (r0 = 0; r0 < m; r0 += rb) {
+        int nr = (m - r0 < rb) ? m - r0 : rb;
+
+        for (r = 0; r < nr; r++)
+            memcpy(X[r], A[r0 + r], n * sizeof(T));
+        matmul(nr, n, n, X, B, &A[r0]);
+    }
+
+    free2d(X);
+}
+
+/* The divide-and-conquer and Jacobi solvers are implemented in double
+ * precision only, and are only reached from the double entry points.
+ */
+static void run_jacobi(double** A, int n, int m, double* w, double** V)
+{
+    jacobi(A, n, m, w, V);
+}
+
+template <typename T>
+static void run_jacobi(T**, int, int, T*, T**)
+{
+    quit("svd(): the Jacobi solver is only available in double precision\n");
+}
+
+static void run_bdc(int n, double* d, double* e, double** U, double** V)
+{
+    bdc(n, d, e, U, V);
+}
+
+template <typename T>
+static void run_bdc(int, T*, T*, T**, T**)
+{
+    quit("svd(): the divide-and-conquer solver is only available in double precision\n");
+}
+
+/* Computes the SVD with the given solver for the bidiagonal form, reducing
+ * wide and tall matrices first.
+ * @param A Input matrix A [0..m-1][0..n-1]; output matrix U (destroyed if
+ *          V is NULL)
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Ouput vector [0..min(m,n)-1]
+ * @param V Output matrix V [0..n-1][0..min(m,n)-1] or NULL for singular
+ *          values only
+ * @param engine Solver for the bidiagonal form (SVD_ENGINE_*)
+ * @param nthreads Number of threads of the QR sweep (see bidiag_qr())
+ */
+template <typename T>
+static void svd_run(T** A, int n, int m, T* w, T** V, int engine, int nthreads)
+{
+    double dm = m, dn = n;
+    double t0;
+    T* rv1;
+    T tst1;
+
+    assert(m > 0 && n > 0);
+
+    if (m < n) {
+        svd_wide(A, n, m, w, V, engine, nthreads);
+        return;
+    }
+    if (m >= SVD_TALL * n) {
+        svd_tall(A, n, m, w, V, engine, nthreads);
+        return;
+    }
+
+    if (engine == SVD_ENGINE_JACOBI) {
+        t0 = phase_start();
+        run_jacobi(A, n, m, w, V);
+        phase_end(SVD_PHASE_DIAG, t0, 0.0);
+        return;
+    }
+
+    rv1 = (T*)(malloc(n * sizeof(T)));
+
+    t0 = phase_start();
+    tst1 = bidiag(A, n, m, w, rv1);
+    phase_end(SVD_PHASE_BIDIAG, t0, 4.0 * dm * dn * dn - 4.0 * dn * dn * dn / 3.0);
+    if (V == NULL) {
+        t0 = phase_start();
+        phase_end(SVD_PHASE_DIAG, t0, qr_sweep(n, w, rv1, tst1, (T**) NULL, m, (T**) NULL, n, nthreads, svd_stat));
+    } else {
+        t0 = phase_start();
+        accum_right(A, n, rv1, V);
+        phase_end(SVD_PHASE_RIGHT, t0, 4.0 * dn * dn * dn / 3.0);
+        t0 = phase_start();
+        accum_left(A, n, m, w);
+        phase_end(SVD_PHASE_LEFT, t0, 2.0 * dm * dn * dn - 2.0 * dn * dn * dn / 3.0);
+        t0 = phase_start();
+        if (engine == SVD_ENGINE_DC && n > SVD_DCLEAF) {
+            T** Ub = (T**)(alloc2d(n, n, sizeof(T)));
+            T** Vb = (T**)(alloc2d(n, n, sizeof(T)));
+
+            run_bdc(n, w, &rv1[1], Ub, Vb);
+            matmul_right(A, n, m, Ub);
+            matmul_right(V, n, n, Vb);
+            free2d(Ub);
+            free2d(Vb);
+            /*
+             * the matrix products only
+             */
+            phase_end(SVD_PHASE_DIAG, t0, 2.0 * dn * dn * (dm + dn));
+        } else
+            phase_end(SVD_PHASE_DIAG, t0, qr_sweep(n, w, rv1, tst1, A, m, V, n, nthreads, svd_stat));
+    }
+
+    free(rv1);
+}
+
+/* Computes the SVD of a matrix with m >= n by the QR sweep directly, with
+ * the superdiagonal held in caller-provided workspace, so that small
+ * matrices are decomposed without allocating.
+ * @param A Input matrix A [0..m-1][0..n-1]; output matrix U [0..m-1][0..n-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Ouput vector [0..n-1]
+ * @param V Output matrix V [0..n-1][0..n-1]
+ * @param rv1 Workspace [0..n-1]
+ */
+template <typename T>
+void svd_small(T** A, int n, int m, T* w, T** V, T* rv1)
+{
+    T tst1;
+
+    assert(m >= n && n > 0);
+
+    tst1 = bidiag(A, n, m, w, rv1);
+    accum_right(A, n, rv1, V);
+    accum_left(A, n, m, w);
+    bidiag_qr(n, w, rv1, tst1, A, m, V, n, 1);
+}
+
+template void matmul(int, int, int, double**, double**, double**);
+template double householder(int, double*, double*, double*);
+template void bidiag_qr(int, double*, double*, double, double**, int, double**, int, int);
+template void bidiag_qr(int, float*, float*, float, float**, int, float**, int, int);
+template void svd_small(double**, int, int, double*, double**, double*);
+
+/** Performs singular value decomposition for a dense matrix.
+ * Borrowed from EISPACK (1972-1973).
+ *
+ * The input matrix A is presented as  A = U.W.V'. Only the k = min(m,n)
+ * singular triplets are formed: wide matrices (m < n) are reduced by a row
+ * LQ factorisation, i.e. A' is decomposed without being formed.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]; output matrix U [0..m-1][0..k-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Ouput vector [0..k-1] that presents diagonal matrix W 
+ * @param V output matrix V [0..n-1][0..k-1] (not transposed)
+ */
+void svd(double** A, int n, int m, double* w, double** V)
+{
+    svd_run(A, n, m, w, V, SVD_ENGINE_QR, 1);
+}
 
-    memcpy(wold, w, n * sizeof(double));
-    memcpy(&aold[0][0], &A[0][0], m * n * sizeof(double));
-    memcpy(&vold[0][0], &V[0][0], n * n * sizeof(double));
+/** Performs singular value decomposition in single precision; see
+ * svd(double**, ...).
+ */
+void svd(float** A, int n, int m, float* w, float** V)
+{
+    svd_run(A, n, m, w, V, SVD_ENGINE_QR, 1);
+}
 
-    sortvector(n, w, pos);
+/** Performs singular value decomposition in extended precision; see
+ * svd(double**, ...).
+ */
+void svd(long double** A, int n, int m, long double* w, long double** V)
+{
+    svd_run(A, n, m, w, V, SVD_ENGINE_QR, 1);
+}
+
+/** Computes singular values of a dense matrix only.
+ *
+ * Same as svd() but skips the accumulation of U and V and the rotation
+ * updates of the QR sweep.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]; destroyed
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Ouput vector [0..min(m,n)-1] of singular values (not sorted)
+ */
+void svd_values(double** A, int n, int m, double* w)
+{
+    svd_run(A, n, m, w, (double**) NULL, SVD_ENGINE_QR, 1);
+}
+
+/** Computes singular values in single precision; see svd_values(double**,
+ * ...).
+ */
+void svd_values(float** A, int n, int m, float* w)
+{
+    svd_run(A, n, m, w, (float**) NULL, SVD_ENGINE_QR, 1);
+}
+
+/** Computes singular values in extended precision; see
+ * svd_values(double**, ...).
+ */
+void svd_values(long double** A, int n, int m, long double* w)
+{
+    svd_run(A, n, m, w, (long double**) NULL, SVD_ENGINE_QR, 1);
+}
+
+/** Performs singular value decomposition with the divide-and-conquer
+ * solver for the bidiagonal form.
+ *
+ * Same as svd(), but the bidiagonal SVD is computed by bdc() (as LAPACK's
+ * dbdsdc), so that the singular vectors are updated by matrix products
+ * instead of one rotation at a time.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]; output matrix U [0..m-1][0..k-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Ouput vector [0..k-1] that presents diagonal matrix W 
+ * @param V output matrix V [0..n-1][0..k-1] (not transposed)
+ */
+void svd_dc(double** A, int n, int m, double* w, double** V)
+{
+    svd_run(A, n, m, w, V, SVD_ENGINE_DC, 1);
+}
+
+/** Performs singular value decomposition by the one-sided Jacobi method.
+ *
+ * Same as svd(), but the columns of A are orthogonalised by Jacobi
+ * rotations (see jacobi()) instead of going through the bidiagonal form.
+ * Small singular values of graded matrices are obtained to high relative
+ * accuracy, and the independent rotations of each step run in parallel.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]; output matrix U [0..m-1][0..k-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Ouput vector [0..k-1] that presents diagonal matrix W 
+ * @param V output matrix V [0..n-1][0..k-1] (not transposed)
+ */
+void svd_jacobi(double** A, int n, int m, double* w, double** V)
+{
+    svd_run(A, n, m, w, V, SVD_ENGINE_JACOBI, 1);
+}
+
+/** Performs singular value decomposition with a multithreaded QR sweep.
+ *
+ * Same as svd(), with the rotations of the QR sweep applied by nthreads
+ * threads.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]; output matrix U [0..m-1][0..k-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Ouput vector [0..k-1] that presents diagonal matrix W 
+ * @param V output matrix V [0..n-1][0..k-1] (not transposed)
+ * @param nthreads Number of threads; 0 for the OpenMP default
+ */
+void svd_mt(double** A, int n, int m, double* w, double** V, int nthreads)
+{
+    svd_run(A, n, m, w, V, SVD_ENGINE_QR, nthreads);
+}
+
+/* Sorts the singular triplets; see svd_sort(). */
+template <typename T>
+static void sort_triplets(T** A, int n, int m, T* w, T** V)
+{
+    int k = (m < n) ? m : n;
+    int* pos = (int*)(malloc(k * sizeof(int)));
+    T* wold = (T*)(malloc(k * sizeof(T)));
+    T** aold = (T**)(alloc2d(k, m, sizeof(T)));
+    T** vold = (T**)(alloc2d(k, n, sizeof(T)));
+    double t0 = phase_start();
+    T wmax;
+    int i, j;
+
+    memcpy(wold, w, k * sizeof(T));
+    for (j = 0; j < m; ++j)
+        memcpy(aold[j], A[j], k * sizeof(T));
+    for (j = 0; j < n; ++j)
+        memcpy(vold[j], V[j], k * sizeof(T));
+
+    sortvector(k, w, pos);
 
     wmax = w[pos[0]];
 
-    for (i = 0; i < n; ++i) {
+    for (i = 0; i < k; ++i) {
         w[i] = wold[pos[i]];
 
-        if (w[i] / wmax < SVD_EPS)
+        if (w[i] / wmax < SVD_EPS * std::numeric_limits<T>::epsilon())
             w[i] = 0.0;
 
         for (j = 0; j < m; ++j)
@@ -494,29 +1783,43 @@ void svd_sort(double** A, int n, int m, double* w, double** V)
     free2d(aold);
     free2d(vold);
 
-    if (svd_verbose) {
-        fprintf(stderr, "\n");
-        fflush(stderr);
-    }
+    phase_end(SVD_PHASE_SORT, t0, 0.0);
 }
 
-/** Computes inverse of the matrix A using SVD.
+/** Performs sorting of SVD results in order of decreasing singular values.
  *
- * @param A Input matrix A [0..m-1][0..n-1]
+ * @param A Input-output matrix U [0..m-1][0..k-1], k = min(m,n)
  * @param n Number of columns
  * @param m Number of rows
- * @param w Input vector [0..n-1] that presents diagonal matrix W 
- * @param V Input matrix V [0..n-1][0..n-1] (not transposed)
- * @param A_inv Output matrix A_invs [0..n-1][0..m-1]
+ * @param w Input-ouput vector [0..k-1] that presents diagonal matrix W 
+ * @param V Input-output matrix V [0..n-1][0..k-1] (not transposed)
+ *
+ * This function does the work but has downside that it requires temporal 
+ * storage equal to the main storage. This may be  a problem for some large
+ * applications, but one does not usually use dense SVD in such cases.
  */
-void svd_invs(double** A, int n, int m, double* w, double** V, double** A_inv)
+void svd_sort(double** A, int n, int m, double* w, double** V)
+{
+    sort_triplets(A, n, m, w, V);
+}
+
+void svd_sort(float** A, int n, int m, float* w, float** V)
+{
+    sort_triplets(A, n, m, w, V);
+}
+
+void svd_sort(long double** A, int n, int m, long double* w, long double** V)
+{
+    sort_triplets(A, n, m, w, V);
+}
+
+/* Forms the pseudo-inverse V.W^-1.U'; see svd_invs(). */
+template <typename T>
+static void pinv(T** A, int n, int m, T* w, T** V, T** A_inv)
 {
-    double** vtemp = (double**)(alloc2d(n, n, sizeof(double)));
     int mnmin;
     int i, j, k;
 
-    memcpy(&vtemp[0][0], &V[0][0], n * n * sizeof(double));
-
     mnmin = (n < m) ? n : m;
 
     for (i = 0; i < mnmin; ++i)
@@ -541,116 +1844,28 @@ void svd_invs(double** A, int n, int m, double* w, double** V, double** A_inv)
             }
         }
     }
-
-    free2d(vtemp);
 }
 
-static void usage()
+/** Computes inverse of the matrix A using SVD.
+ *
+ * @param A Input matrix U [0..m-1][0..k-1], k = min(m,n)
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Input vector [0..k-1] that presents diagonal matrix W 
+ * @param V Input matrix V [0..n-1][0..k-1] (not transposed)
+ * @param A_inv Output matrix A_invs [0..n-1][0..m-1]
+ */
+void svd_invs(double** A, int n, int m, double* w, double** V, double** A_inv)
 {
-    printf("Usage: svd <ncolumns> <nrows> <a_11> <a_12> ... <a_mn>\n");
-    printf("E.g.:\n");
-    printf("  ./svd 4 3 1 0 0 1 -1 0 2 1 1 2 0 1\n");
-    printf("  ./svd 3 4 1 0 0 1 -1 0 2 1 1 2 0 1\n");
-    exit(0);
+    pinv(A, n, m, w, V, A_inv);
 }
 
-static void matrix_print(int n, int m, double** A, const char* offset)
+void svd_invs(float** A, int n, int m, float* w, float** V, float** A_inv)
 {
-    int i, j;
-
-    for (j = 0; j < m; ++j) {
-        printf("%s", offset);
-        for (i = 0; i < n; ++i)
-            printf("%10.5g ", fabs(A[j][i]) < SVD_EPS ? 0.0 : A[j][i]);
-        printf("\n");
-    }
+    pinv(A, n, m, w, V, A_inv);
 }
 
-int main(int argc, char* argv[])
+void svd_invs(long double** A, int n, int m, long double* w, long double** V, long double** A_inv)
 {
-    int m, n, mnmin, mnmax, i, j, k;
-    double** A = nullptr;
-    double** A_inv = nullptr;
-    double** V = NULL;
-    double* w = NULL;
-    double** W = NULL;
-
-    if (argc < 4)
-        usage();
-
-    n = atoi(argv[1]);
-    m = atoi(argv[2]);
-    mnmin = (n < m) ? n : m;
-    mnmax = (n > m) ? n : m;
-
-    if (n <= 0)
-        quit("n = %d; expected n > 0\n", n);
-    if (m <= 0)
-        quit("m = %d; expected m > 0\n", m);
-
-    if (argc != m * n + 3)
-        usage();
-
-    A = (double**)(alloc2d(n, m, sizeof(double)));
-    A_inv = (double**)(alloc2d(m, n, sizeof(double)));
-
-    for (j = 0, k = 3; j < m; ++j)
-        for (i = 0; i < n; ++i, ++k)
-            A[j][i] = atof(argv[k]);
-
-    printf("A = \n");
-    matrix_print(n, m, A, "  ");
-
-    V = (double**)(alloc2d(n, n, sizeof(double)));
-    w = (double*)(malloc(mnmax * sizeof(double)));
-    W = (double**)(alloc2d(n, mnmax, sizeof(double)));
-
-    printf("performing SVD:");
-
-    svd(A, n, m, w, V);
-
-    printf(" done\n");
-
-    for (i = 0; i < n; ++i)
-        W[i][i] = w[i];
-
-    printf("U =\n");
-    matrix_print(n, m, A, "  ");
-    printf("W = \n");
-    matrix_print(n, n, W, "  ");
-    printf("V =\n");
-    matrix_print(n, n, V, "  ");
-
-    printf("performing sorting:");
-
-    svd_sort(A, n, m, w, V);
-
-    printf(" done\n");
-
-    for (i = 0; i < n; ++i)
-        W[i][i] = w[i];
-
-    printf("U =\n");
-    matrix_print(m, m, A, "  ");
-    printf("W = \n");
-    matrix_print(m, n, W, "  ");
-    printf("V =\n");
-    matrix_print(n, n, V, "  ");
-
-    printf("performing inverse:");
-
-    svd_invs(A, n, m, w, V, A_inv);
-
-    printf(" done\n");
-
-    printf("A.T =\n");
-    matrix_print(n, m, A_inv, "  ");
-
-    free2d(A);
-    free(w);
-    free2d(V);
-    free2d(W);
-    free2d(A_inv);
-
-    return 0;
-}
\ No newline at end of file
+    pinv(A, n, m, w, V, A_inv);
+}
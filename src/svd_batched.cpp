@@ -0,0 +1,216 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+
+#include "svd.hpp"
+#include "svd_internal.hpp"
+
+#define SVD_BCHUNK 8            /* batch members per scheduling chunk */
+
+typedef struct {
+    double cost;
+    int i;
+} costentry;
+
+static int cmp_cost(const void* p1, const void* p2)
+{
+    double c1 = ((costentry *) p1)->cost;
+    double c2 = ((costentry *) p2)->cost;
+
+    if (c1 > c2)
+        return -1;
+    if (c1 < c2)
+        return 1;
+    return 0;
+}
+
+/* Per-thread workspace, sized for the largest member of the batch. */
+typedef struct {
+    double** rowa;
+    double** rowv;
+    double* rv1;
+    double* buf;
+} workspace;
+
+static void ws_init(workspace* ws, int nmax, int mmax)
+{
+    int kmax = (nmax < mmax) ? nmax : mmax;
+    int rmax = (nmax > mmax) ? nmax : mmax;
+
+    ws->rowa = (double**)(malloc(rmax * sizeof(double*)));
+    ws->rowv = (double**)(malloc(rmax * sizeof(double*)));
+    ws->rv1 = (double*)(malloc(rmax * sizeof(double)));
+    ws->buf = (double*)(malloc((size_t) kmax * kmax * sizeof(double)));
+    if (ws->rowa == NULL || ws->rowv == NULL || ws->rv1 == NULL || ws->buf == NULL)
+        quit("svd_batched(): could not allocate workspace\n");
+}
+
+static void ws_free(workspace* ws)
+{
+    free(ws->rowa);
+    free(ws->rowv);
+    free(ws->rv1);
+    free(ws->buf);
+}
+
+/* Decomposes one member of the batch in place. Wide members are decomposed
+ * as A' = V.W.U', with A' formed in the storage of V.
+ */
+static void svd_member(double* A, int n, int m, double* w, double* V, workspace* ws)
+{
+    int i, j;
+
+    if (m >= n) {
+        for (i = 0; i < m; i++)
+            ws->rowa[i] = &A[(size_t) i * n];
+        for (i = 0; i < n; i++)
+            ws->rowv[i] = &V[(size_t) i * n];
+        svd_small(ws->rowa, n, m, w, ws->rowv, ws->rv1);
+    } else {
+        for (i = 0; i < m; i++)
+            for (j = 0; j < n; j++)
+                V[(size_t) j * m + i] = A[(size_t) i * n + j];
+        for (j = 0; j < n; j++)
+            ws->rowa[j] = &V[(size_t) j * m];
+        for (i = 0; i < m; i++)
+            ws->rowv[i] = &ws->buf[(size_t) i * m];
+        svd_small(ws->rowa, m, n, w, ws->rowv, ws->rv1);
+        for (i = 0; i < m; i++)
+            memcpy(&A[(size_t) i * n], ws->rowv[i], m * sizeof(double));
+    }
+}
+
+/** Performs singular value decomposition for a batch of small dense
+ * matrices.
+ *
+ * The matrices are stored one after another in contiguous arrays. Member
+ * i is m_i x n_i, with k_i = min(m_i,n_i):
+ *   A: m_i x n_i, row-major; on output U [0..m_i-1][0..k_i-1] with row
+ *      stride n_i;
+ *   w: k_i singular values (not sorted);
+ *   V: n_i x k_i, row-major (not transposed).
+ *
+ * Each member is decomposed as by svd() (without the QR/LQ reduction of
+ * very tall or wide matrices), with the workspace allocated once per thread
+ * for the whole batch rather than per matrix. With OpenMP the members are
+ * shared between threads dynamically, in chunks of SVD_BCHUNK; members of
+ * heterogeneous batches are scheduled in order of decreasing cost.
+ *
+ * Uniform batches of matrices up to SVD_SOAMAX x SVD_SOAMAX go to svd_soa()
+ * instead, SVD_LANES matrices at a time, which vectorises across matrices.
+ *
+ * @param count Number of matrices
+ * @param n Number of columns of each matrix [0..count-1], or of all matrices
+ *          if inc is 0
+ * @param m Number of rows of each matrix [0..count-1], or of all matrices if
+ *          inc is 0
+ * @param inc 1 for heterogeneous sizes, 0 for uniform sizes
+ * @param A Input matrices A; output matrices U
+ * @param w Output singular values
+ * @param V Output matrices V
+ */
+void svd_batched(int count, const int* n, const int* m, int inc, double* A, double* w, double* V)
+{
+    size_t* offa;
+    size_t* offw;
+    size_t* offv;
+    int* order;
+    int nmax = 0, mmax = 0;
+    int i;
+
+    if (count <= 0)
+        return;
+    if (inc != 0 && inc != 1)
+        quit("svd_batched(): invalid increment (inc = %d)\n", inc);
+
+    offa = (size_t*)(malloc((count + 1) * sizeof(size_t)));
+    offw = (size_t*)(malloc((count + 1) * sizeof(size_t)));
+    offv = (size_t*)(malloc((count + 1) * sizeof(size_t)));
+    order = (int*)(malloc(count * sizeof(int)));
+
+    offa[0] = offw[0] = offv[0] = 0;
+    for (i = 0; i < count; i++) {
+        int ni = n[i * inc];
+        int mi = m[i * inc];
+        int ki = (ni < mi) ? ni : mi;
+
+        if (ni <= 0 || mi <= 0)
+            quit("svd_batched(): invalid size of matrix %d (n = %d, m = %d)\n", i, ni, mi);
+        offa[i + 1] = offa[i] + (size_t) mi * ni;
+        offw[i + 1] = offw[i] + ki;
+        offv[i + 1] = offv[i] + (size_t) ni * ki;
+        nmax = (ni > nmax) ? ni : nmax;
+        mmax = (mi > mmax) ? mi : mmax;
+        order[i] = i;
+    }
+
+    if (inc) {
+        /*
+         * largest first, so that the tail of the schedule is made of small
+         * members
+         */
+        costentry* ce = (costentry*)(malloc(count * sizeof(costentry)));
+
+        for (i = 0; i < count; i++) {
+            double ni = n[i];
+            double mi = m[i];
+
+            ce[i].cost = (mi >= ni) ? mi * ni * ni : ni * mi * mi;
+            ce[i].i = i;
+        }
+        qsort(ce, count, sizeof(costentry), cmp_cost);
+        for (i = 0; i < count; i++)
+            order[i] = ce[i].i;
+        free(ce);
+    }
+
+    if (inc == 0 && n[0] <= SVD_SOAMAX && m[0] <= SVD_SOAMAX) {
+        /*
+         * small uniform batch: SVD_LANES matrices at a time, vectorised
+         * across matrices; the last group is padded by repeating its first
+         * member
+         */
+        int ngroups = (count + SVD_LANES - 1) / SVD_LANES;
+        int g;
+
+#pragma omp parallel for schedule(dynamic, SVD_BCHUNK)
+        for (g = 0; g < ngroups; g++) {
+            double* pa[SVD_LANES];
+            double* pw[SVD_LANES];
+            double* pv[SVD_LANES];
+            int v;
+
+            for (v = 0; v < SVD_LANES; v++) {
+                int t = g * SVD_LANES + v;
+
+                if (t >= count)
+                    t = g * SVD_LANES;
+                pa[v] = &A[offa[t]];
+                pw[v] = &w[offw[t]];
+                pv[v] = &V[offv[t]];
+            }
+            svd_soa(n[0], m[0], pa, pw, pv);
+        }
+    } else {
+#pragma omp parallel
+        {
+            workspace ws;
+            int j;
+
+            ws_init(&ws, nmax, mmax);
+#pragma omp for schedule(dynamic, SVD_BCHUNK)
+            for (j = 0; j < count; j++) {
+                int t = order[j];
+
+                svd_member(&A[offa[t]], n[t * inc], m[t * inc], &w[offw[t]], &V[offv[t]], &ws);
+            }
+            ws_free(&ws);
+        }
+    }
+
+    free(offa);
+    free(offw);
+    free(offv);
+    free(order);
+}
@@ -0,0 +1,273 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <complex>
+
+#include "svd.hpp"
+#include "svd_internal.hpp"
+
+/* Generates a Householder reflector H = I - tau.v.v^H such that
+ * H^H.x = beta.e1 with beta real (as LAPACK's zlarfg).
+ * On exit x[1..n-1] contains v[1..n-1] and x[0] = 1.
+ * @param n Length of x
+ * @param x Input vector; output reflector
+ * @param tau Output scalar factor
+ * @return beta
+ */
+template <typename T>
+static T chouseholder(int n, std::complex<T>* x, std::complex<T>* tau)
+{
+    std::complex<T> alpha = x[0];
+    T scale = std::fabs(alpha.real()) + std::fabs(alpha.imag());
+    T s, beta;
+    int i;
+
+    for (i = 1; i < n; i++)
+        scale += std::fabs(x[i].real()) + std::fabs(x[i].imag());
+    if (scale == T(0) || (scale == std::fabs(alpha.real()) && alpha.imag() == T(0))) {
+        /*
+         * x is already a real multiple of e1
+         */
+        *tau = 0;
+        x[0] = 1;
+        return alpha.real();
+    }
+    s = 0;
+    for (i = 0; i < n; i++)
+        s += std::norm(x[i] / scale);
+    beta = -std::copysign(scale * std::sqrt(s), alpha.real());
+    *tau = std::complex<T>((beta - alpha.real()) / beta, -alpha.imag() / beta);
+    alpha = T(1) / (alpha - beta);
+    for (i = 1; i < n; i++)
+        x[i] *= alpha;
+    x[0] = 1;
+
+    return beta;
+}
+
+/* Applies H = I - tau.v.v^H from the left to the rows r0..r0+n-1, columns
+ * c0..c1-1 of X: X = H.X.
+ */
+template <typename T>
+static void capply_left(int n, const std::complex<T>* v, std::complex<T> tau, std::complex<T>** X, int r0, int c0, int c1, std::complex<T>* work)
+{
+    int i, j;
+
+    if (tau == std::complex<T>(0))
+        return;
+    for (j = c0; j < c1; j++)
+        work[j] = 0;
+    for (i = 0; i < n; i++) {
+        std::complex<T> cv = std::conj(v[i]);
+        std::complex<T>* x = X[r0 + i];
+
+        for (j = c0; j < c1; j++)
+            work[j] += cv * x[j];
+    }
+    for (i = 0; i < n; i++) {
+        std::complex<T> f = tau * v[i];
+        std::complex<T>* x = X[r0 + i];
+
+        for (j = c0; j < c1; j++)
+            x[j] -= f * work[j];
+    }
+}
+
+/* Applies H = I - tau.v.v^H from the right to the rows r0..r1-1, columns
+ * c0..c0+n-1 of X: X = X.H.
+ */
+template <typename T>
+static void capply_right(int n, const std::complex<T>* v, std::complex<T> tau, std::complex<T>** X, int r0, int r1, int c0)
+{
+    int i, j;
+
+    if (tau == std::complex<T>(0))
+        return;
+    for (i = r0; i < r1; i++) {
+        std::complex<T>* x = &X[i][c0];
+        std::complex<T> s = 0;
+
+        for (j = 0; j < n; j++)
+            s += x[j] * v[j];
+        s *= tau;
+        for (j = 0; j < n; j++)
+            x[j] -= s * std::conj(v[j]);
+    }
+}
+
+/* Complex SVD of a matrix with m >= n.
+ *
+ * A is reduced to a real upper bidiagonal matrix, A = Q.B.P^H, by complex
+ * Householder reflectors chosen so that the diagonal and superdiagonal come
+ * out real (as LAPACK's zgebd2). B = U_B.W.V_B' is then diagonalised by the
+ * real QR sweep, bidiag_qr(), whose rotations are real: they are applied to
+ * the real and imaginary parts of Q and P together, stacked as real
+ * matrices [Re; Im] with twice the rows. U = Q.U_B and V = P.V_B.
+ */
+template <typename T>
+static void csvd_tall(std::complex<T>** A, int n, int m, T* w, std::complex<T>** V)
+{
+    typedef std::complex<T> C;
+    C* tauq = (C*)(malloc(n * sizeof(C)));
+    C* taup = (C*)(malloc(n * sizeof(C)));
+    C* x = (C*)(malloc(((m > n) ? m : n) * sizeof(C)));
+    C* work = (C*)(malloc(((m > n) ? m : n) * sizeof(C)));
+    C** Q;
+    T* rv1 = (T*)(malloc(n * sizeof(T)));
+    T** Ur;
+    T** Vr;
+    T tst1 = 0;
+    int i, j, t;
+
+    if (svd_verbose) {
+        fprintf(stderr, "  svd: complex householder reduction of a %d x %d matrix\n", m, n);
+        fflush(stderr);
+    }
+
+    rv1[0] = 0;
+    for (i = 0; i < n; i++) {
+        int l = m - i;
+
+        /*
+         * left reflector: column i below the diagonal
+         */
+        for (t = 0; t < l; t++)
+            x[t] = A[i + t][i];
+        w[i] = chouseholder(l, x, &tauq[i]);
+        capply_left(l, x, std::conj(tauq[i]), A, i, i + 1, n, work);
+        for (t = 1; t < l; t++)
+            A[i + t][i] = x[t];
+
+        if (i == n - 1)
+            break;
+
+        /*
+         * right reflector: row i to the right of the superdiagonal; the
+         * reflector of conj(row) makes row.H = beta.e1'
+         */
+        l = n - i - 1;
+        for (t = 0; t < l; t++)
+            x[t] = std::conj(A[i][i + 1 + t]);
+        rv1[i + 1] = chouseholder(l, x, &taup[i]);
+        capply_right(l, x, taup[i], A, i + 1, m, i + 1);
+        for (t = 1; t < l; t++)
+            A[i][i + 1 + t] = x[t];
+    }
+    for (i = 0; i < n; i++) {
+        T tmp = std::fabs(w[i]) + std::fabs(rv1[i]);
+
+        tst1 = (tst1 > tmp) ? tst1 : tmp;
+    }
+
+    /*
+     * accumulation of P = G_0...G_{n-2} in V and of Q = H_0...H_{n-1} in Q,
+     * backwards
+     */
+    for (i = 0; i < n; i++)
+        for (j = 0; j < n; j++)
+            V[i][j] = (i == j) ? 1 : 0;
+    for (i = n - 2; i >= 0; i--) {
+        int l = n - i - 1;
+
+        x[0] = 1;
+        for (t = 1; t < l; t++)
+            x[t] = A[i][i + 1 + t];
+        capply_left(l, x, taup[i], V, i + 1, i + 1, n, work);
+    }
+    Q = (C**)(alloc2d(n, m, sizeof(C)));
+    for (i = 0; i < n; i++)
+        Q[i][i] = 1;
+    for (i = n - 1; i >= 0; i--) {
+        int l = m - i;
+
+        x[0] = 1;
+        for (t = 1; t < l; t++)
+            x[t] = A[i + t][i];
+        capply_left(l, x, tauq[i], Q, i, i, n, work);
+    }
+
+    /*
+     * diagonalisation, rotating [Re; Im] of Q and P
+     */
+    Ur = (T**)(alloc2d(n, 2 * m, sizeof(T)));
+    Vr = (T**)(alloc2d(n, 2 * n, sizeof(T)));
+    for (i = 0; i < m; i++)
+        for (j = 0; j < n; j++) {
+            Ur[i][j] = Q[i][j].real();
+            Ur[m + i][j] = Q[i][j].imag();
+        }
+    for (i = 0; i < n; i++)
+        for (j = 0; j < n; j++) {
+            Vr[i][j] = V[i][j].real();
+            Vr[n + i][j] = V[i][j].imag();
+        }
+    bidiag_qr(n, w, rv1, tst1, Ur, 2 * m, Vr, 2 * n, 1);
+    for (i = 0; i < m; i++)
+        for (j = 0; j < n; j++)
+            A[i][j] = C(Ur[i][j], Ur[m + i][j]);
+    for (i = 0; i < n; i++)
+        for (j = 0; j < n; j++)
+            V[i][j] = C(Vr[i][j], Vr[n + i][j]);
+
+    free2d(Q);
+    free2d(Ur);
+    free2d(Vr);
+    free(tauq);
+    free(taup);
+    free(x);
+    free(work);
+    free(rv1);
+}
+
+/* Complex SVD; wide matrices are decomposed through A^H = V.W.U^H. */
+template <typename T>
+static void csvd(std::complex<T>** A, int n, int m, T* w, std::complex<T>** V)
+{
+    typedef std::complex<T> C;
+    C** B;
+    C** VB;
+    int i, j;
+
+    if (m >= n) {
+        csvd_tall(A, n, m, w, V);
+        return;
+    }
+
+    B = (C**)(alloc2d(m, n, sizeof(C)));
+    VB = (C**)(alloc2d(m, m, sizeof(C)));
+    for (i = 0; i < m; i++)
+        for (j = 0; j < n; j++)
+            B[j][i] = std::conj(A[i][j]);
+    csvd_tall(B, m, n, w, VB);
+    for (i = 0; i < n; i++)
+        for (j = 0; j < m; j++)
+            V[i][j] = B[i][j];
+    for (i = 0; i < m; i++)
+        for (j = 0; j < m; j++)
+            A[i][j] = VB[i][j];
+    free2d(B);
+    free2d(VB);
+}
+
+/** Performs singular value decomposition for a dense complex matrix,
+ * A = U.W.V^H with W real.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]; output matrix U [0..m-1][0..k-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Ouput vector [0..k-1] of singular values (not sorted)
+ * @param V output matrix V [0..n-1][0..k-1] (not conjugate-transposed)
+ */
+void svd(std::complex<double>** A, int n, int m, double* w, std::complex<double>** V)
+{
+    csvd(A, n, m, w, V);
+}
+
+/** Performs complex singular value decomposition in single precision; see
+ * svd(std::complex<double>**, ...).
+ */
+void svd(std::complex<float>** A, int n, int m, float* w, std::complex<float>** V)
+{
+    csvd(A, n, m, w, V);
+}
@@ -0,0 +1,537 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <float.h>
+
+#include "svd.hpp"
+#include "svd_internal.hpp"
+
+#define SVD_DCMAXIT 64          /* iterations of the secular equation solver */
+#define SVD_DCTASK 200          /* smallest subproblem spawned as a task */
+
+typedef struct {
+    double d;
+    int i;
+} sortentry;
+
+static int cmp_se(const void* p1, const void* p2)
+{
+    double d1 = ((sortentry *) p1)->d;
+    double d2 = ((sortentry *) p2)->d;
+
+    if (d1 < d2)
+        return -1;
+    if (d1 > d2)
+        return 1;
+    return 0;
+}
+
+/* Solves a leaf of the recursion by the QR sweep. The extra column of a
+ * non-square leaf is first rotated away from the right (as in LAPACK's
+ * dlasdq), B.G = [B' 0], so that V = G.diag(V', 1).
+ * @param n Number of rows
+ * @param sqre 1 if the matrix is n x (n+1), 0 if it is square
+ * @param d Input diagonal [0..n-1]; output singular values
+ * @param e Input superdiagonal [0..n+sqre-2] (e[i] = B[i][i+1]); destroyed
+ * @param U Output matrix [0..n-1][0..n-1]
+ * @param V Output matrix [0..n+sqre-1][0..n+sqre-1]
+ */
+static void bdc_leaf(int n, int sqre, double* d, double* e, double** U, double** V)
+{
+    int nv = n + sqre;
+    double* rv1 = (double*)(malloc(n * sizeof(double)));
+    double tst1 = 0.0;
+    int i, j;
+
+    for (i = 0; i < n; i++) {
+        memset(U[i], 0, n * sizeof(double));
+        U[i][i] = 1.0;
+    }
+    for (i = 0; i < nv; i++) {
+        memset(V[i], 0, nv * sizeof(double));
+        V[i][i] = 1.0;
+    }
+
+    if (sqre) {
+        double f = e[n - 1];
+
+        for (i = n - 1; i >= 0; i--) {
+            double r = hypot(d[i], f);
+            double c = 1.0, s = 0.0;
+
+            if (r != 0.0) {
+                c = d[i] / r;
+                s = f / r;
+            }
+            d[i] = r;
+            if (i > 0) {
+                f = -s * e[i - 1];
+                e[i - 1] *= c;
+            }
+            for (j = 0; j < nv; j++) {
+                double x = V[j][i];
+                double y = V[j][n];
+
+                V[j][i] = c * x + s * y;
+                V[j][n] = c * y - s * x;
+            }
+        }
+    }
+
+    rv1[0] = 0.0;
+    for (i = 1; i < n; i++)
+        rv1[i] = e[i - 1];
+    for (i = 0; i < n; i++) {
+        double tmp = fabs(d[i]) + fabs(rv1[i]);
+
+        tst1 = (tst1 > tmp) ? tst1 : tmp;
+    }
+    bidiag_qr(n, d, rv1, tst1, U, n, V, nv, 1);
+
+    free(rv1);
+}
+
+/* Finds the j-th root of the secular equation
+ *
+ *   f(s) = 1 + sum_i z[i]^2 / (d[i]^2 - s^2) = 0,
+ *
+ * 0 = d[0] < d[1] < ... < d[k-1], which lies in (d[j], d[j+1]). The root is
+ * returned as s = d[org] + tau relative to the nearer pole, so that all
+ * differences d[i] - s can be formed to high relative accuracy.
+ *
+ * Each step fits one pole on either side of the root to f (value and
+ * derivative) and solves the resulting quadratic, safeguarded by bisection.
+ *
+ * @param k Number of poles
+ * @param d Poles [0..k-1]
+ * @param z Weights [0..k-1]
+ * @param zz Sum of z[i]^2
+ * @param j Index of the root
+ * @param org Output origin of the root
+ * @return tau
+ */
+static double secular_root(int k, const double* d, const double* z, double zz, int j, int* org)
+{
+    double lo = d[j];
+    double hi = (j < k - 1) ? d[j + 1] : d[k - 1] + sqrt(zz);
+    double half = 0.5 * (hi - lo);
+    double tlo, thi, tau, p, f = 1.0;
+    int o, i, it;
+
+    for (i = 0; i < k; i++)
+        f += z[i] * z[i] / ((d[i] - lo - half) * (d[i] + lo + half));
+    if (f >= 0.0) {
+        o = j;
+        tlo = 0.0;
+        thi = half;
+    } else if (j < k - 1) {
+        o = j + 1;
+        tlo = -half;
+        thi = 0.0;
+    } else {
+        o = j;
+        tlo = half;
+        thi = hi - lo;
+    }
+    p = d[o];
+    tau = 0.5 * (tlo + thi);
+
+    for (it = 0; it < SVD_DCMAXIT; it++) {
+        double psi = 0.0, dpsi = 0.0, phi = 0.0, dphi = 0.0;
+        double a = 0.0, b = 0.0, s, sn, eta, tnew;
+
+        for (i = 0; i < k; i++) {
+            double delta = ((d[i] - p) - tau) * (d[i] + p + tau);
+            double t = z[i] / delta;
+
+            if (i <= j) {
+                psi += z[i] * t;
+                dpsi += t * t;
+            } else {
+                phi += z[i] * t;
+                dphi += t * t;
+            }
+            if (i == j)
+                a = delta;
+            else if (i == j + 1)
+                b = delta;
+        }
+        f = 1.0 + psi + phi;
+        if (fabs(f) <= 8.0 * k * DBL_EPSILON * (1.0 - psi + phi))
+            break;
+        if (f < 0.0)
+            tlo = tau;
+        else
+            thi = tau;
+
+        if (j < k - 1) {
+            double s1 = a * a * dpsi;
+            double s2 = b * b * dphi;
+            double cc = 1.0 + (psi - a * dpsi) + (phi - b * dphi);
+            double qb = cc * (a + b) + s1 + s2;
+            double qc = cc * a * b + s1 * b + s2 * a;
+
+            if (cc == 0.0)
+                eta = qc / qb;
+            else {
+                double disc = qb * qb - 4.0 * cc * qc;
+                double q = 0.5 * (qb + copysign(sqrt((disc > 0.0) ? disc : 0.0), qb));
+
+                eta = q / cc;
+                if (!(eta > a && eta < b) && q != 0.0)
+                    eta = qc / q;
+            }
+        } else {
+            double cc = 1.0 + (psi - a * dpsi) + phi;
+
+            eta = a + a * a * dpsi / cc;
+        }
+
+        s = p + tau;
+        sn = sqrt(s * s + eta);
+        tnew = tau + eta / (sn + s);
+        if (!(tnew > tlo && tnew < thi))
+            tnew = 0.5 * (tlo + thi);
+        if (fabs(tnew - tau) <= 2.0 * DBL_EPSILON * fabs(tnew)) {
+            tau = tnew;
+            break;
+        }
+        tau = tnew;
+        if (thi - tlo <= 4.0 * DBL_EPSILON * fmax(fabs(tlo), fabs(thi)))
+            break;
+    }
+
+    *org = o;
+    return tau;
+}
+
+/* Merges the SVDs of the two halves (dlasd1-dlasd3):
+ *
+ *   B = [B1 0; alpha.e_nl' beta.e_1'; 0 B2]
+ *     = diag(U1, 1, U2).M.diag(V1, V2)',
+ *
+ * where M = [Z; D] after permutation has a dense row z and the diagonal D
+ * = diag(0, S1, S2). Entries of z that are negligible, or that belong to
+ * (nearly) equal diagonal entries, are deflated; the SVD of the remaining
+ * k x k part is obtained from the secular equation, with z recomputed from
+ * the roots (Gu & Eisenstat) so that the singular vectors are orthogonal,
+ * and applied to the block diagonal factors by matrix products.
+ *
+ * @param n Number of rows
+ * @param sqre 1 if B is n x (n+1), 0 if it is square
+ * @param nl Number of rows of B1
+ * @param alpha B[nl][nl]
+ * @param beta B[nl][nl+1]
+ * @param d Input singular values of B1 [0..nl-1] and B2 [nl+1..n-1];
+ *          output singular values of B [0..n-1]
+ * @param U1 Input left singular vectors of B1 [0..nl-1][0..nl-1]
+ * @param V1 Input right singular vectors of B1 [0..nl][0..nl]
+ * @param U2 Input left singular vectors of B2 [0..nr-1][0..nr-1]
+ * @param V2 Input right singular vectors of B2 [0..nr+sqre-1][0..nr+sqre-1]
+ * @param U Output matrix [0..n-1][0..n-1]
+ * @param V Output matrix [0..n+sqre-1][0..n+sqre-1]
+ */
+static void bdc_merge(int n, int sqre, int nl, double alpha, double beta, double* d, double** U1, double** V1, double** U2, double** V2, double** U, double** V)
+{
+    int nr = n - nl - 1;
+    int nv = n + sqre;
+    double** Ub = (double**)(alloc2d(n, n, sizeof(double)));
+    double** Vb = (double**)(alloc2d(nv, nv, sizeof(double)));
+    double* dd = (double*)(malloc(n * sizeof(double)));
+    double* zz = (double*)(malloc(n * sizeof(double)));
+    double* dk = (double*)(malloc(n * sizeof(double)));
+    double* zk = (double*)(malloc(n * sizeof(double)));
+    double* tau = (double*)(malloc(n * sizeof(double)));
+    int* col = (int*)(malloc(n * sizeof(int)));
+    int* kidx = (int*)(malloc(n * sizeof(int)));
+    int* didx = (int*)(malloc(n * sizeof(int)));
+    int* org = (int*)(malloc(n * sizeof(int)));
+    sortentry* se = (sortentry*)(malloc(n * sizeof(sortentry)));
+    double orgnrm, tol, zsq;
+    int i, j, r, t, k = 0, nd = 0, prev = -1;
+
+    for (i = 0; i < nl; i++)
+        memcpy(Ub[i], U1[i], nl * sizeof(double));
+    Ub[nl][nl] = 1.0;
+    for (i = 0; i < nr; i++)
+        memcpy(&Ub[nl + 1 + i][nl + 1], U2[i], nr * sizeof(double));
+    for (i = 0; i <= nl; i++)
+        memcpy(Vb[i], V1[i], (nl + 1) * sizeof(double));
+    for (i = 0; i < nr + sqre; i++)
+        memcpy(&Vb[nl + 1 + i][nl + 1], V2[i], (nr + sqre) * sizeof(double));
+
+    /*
+     * the row z and the diagonal of M; column t of M is column col[t] of
+     * both diag(U1, 1, U2) and diag(V1, V2)
+     */
+    dd[0] = 0.0;
+    zz[0] = alpha * V1[nl][nl];
+    col[0] = nl;
+    for (i = 0; i < nl; i++) {
+        dd[i + 1] = d[i];
+        zz[i + 1] = alpha * V1[nl][i];
+        col[i + 1] = i;
+    }
+    for (i = 0; i < nr; i++) {
+        dd[nl + 1 + i] = d[nl + 1 + i];
+        zz[nl + 1 + i] = beta * V2[0][i];
+        col[nl + 1 + i] = nl + 1 + i;
+    }
+    if (sqre) {
+        /*
+         * rotate the null columns of V1 and V2 into one
+         */
+        double zb = beta * V2[0][nr];
+        double h = hypot(zz[0], zb);
+        double c = 1.0, s = 0.0;
+
+        if (h != 0.0) {
+            c = zz[0] / h;
+            s = zb / h;
+        }
+        zz[0] = h;
+        for (r = 0; r < nv; r++) {
+            double x = Vb[r][nl];
+            double y = Vb[r][n];
+
+            Vb[r][nl] = c * x + s * y;
+            Vb[r][n] = c * y - s * x;
+        }
+    }
+
+    orgnrm = fmax(fabs(alpha), fabs(beta));
+    for (i = 1; i < n; i++)
+        orgnrm = fmax(orgnrm, dd[i]);
+    if (orgnrm == 0.0) {
+        for (i = 0; i < n; i++)
+            d[i] = 0.0;
+        for (i = 0; i < n; i++)
+            memcpy(U[i], Ub[i], n * sizeof(double));
+        for (i = 0; i < nv; i++)
+            memcpy(V[i], Vb[i], nv * sizeof(double));
+        goto out;
+    }
+    for (i = 0; i < n; i++) {
+        dd[i] /= orgnrm;
+        zz[i] /= orgnrm;
+    }
+    tol = 8.0 * DBL_EPSILON;
+
+    /*
+     * deflation
+     */
+    for (i = 1; i < n; i++) {
+        se[i - 1].d = dd[i];
+        se[i - 1].i = i;
+    }
+    qsort(se, n - 1, sizeof(sortentry), cmp_se);
+    kidx[k++] = 0;
+    for (i = 0; i < n - 1; i++) {
+        t = se[i].i;
+        if (fabs(zz[t]) <= tol) {
+            didx[nd++] = t;
+            continue;
+        }
+        if (prev >= 0 && dd[t] - dd[prev] <= tol) {
+            double h = hypot(zz[prev], zz[t]);
+            double c = zz[t] / h;
+            double s = zz[prev] / h;
+            int ct = col[t], cp = col[prev];
+
+            zz[t] = h;
+            zz[prev] = 0.0;
+            for (r = 0; r < n; r++) {
+                double x = Ub[r][ct];
+                double y = Ub[r][cp];
+
+                Ub[r][ct] = c * x + s * y;
+                Ub[r][cp] = c * y - s * x;
+            }
+            for (r = 0; r < nv; r++) {
+                double x = Vb[r][ct];
+                double y = Vb[r][cp];
+
+                Vb[r][ct] = c * x + s * y;
+                Vb[r][cp] = c * y - s * x;
+            }
+            didx[nd++] = prev;
+        } else if (prev >= 0)
+            kidx[k++] = prev;
+        prev = t;
+    }
+    if (prev >= 0)
+        kidx[k++] = prev;
+    if (fabs(zz[0]) <= tol)
+        zz[0] = tol;
+    if (k > 1 && dd[kidx[1]] < tol)
+        dd[kidx[1]] = tol;
+
+    /*
+     * secular equation
+     */
+    zsq = 0.0;
+    for (i = 0; i < k; i++) {
+        dk[i] = dd[kidx[i]];
+        zk[i] = zz[kidx[i]];
+        zsq += zk[i] * zk[i];
+    }
+    if (k == 1) {
+        org[0] = 0;
+        tau[0] = sqrt(zsq);
+    } else {
+#pragma omp parallel for if (k > SVD_DCTASK)
+        for (j = 0; j < k; j++)
+            tau[j] = secular_root(k, dk, zk, zsq, j, &org[j]);
+    }
+
+    {
+        double** Uh = (double**)(alloc2d(k, k, sizeof(double)));
+        double** Vh = (double**)(alloc2d(k, k, sizeof(double)));
+        double** G = (double**)(alloc2d(k, nv, sizeof(double)));
+        double** P = (double**)(alloc2d(k, nv, sizeof(double)));
+
+        /*
+         * z recomputed from the roots (Loewner)
+         */
+        for (i = 0; i < k; i++) {
+            double dj = dk[org[k - 1]] + tau[k - 1];
+            double prod = ((dk[i] - dk[org[k - 1]]) - tau[k - 1]) * (dk[i] + dj);
+
+            for (j = 0; j < k - 1; j++) {
+                int l = (j < i) ? j : j + 1;
+
+                dj = dk[org[j]] + tau[j];
+                prod *= ((dk[i] - dk[org[j]]) - tau[j]) * (dk[i] + dj)
+                    / ((dk[i] - dk[l]) * (dk[i] + dk[l]));
+            }
+            zk[i] = copysign(sqrt(fabs(prod)), zk[i]);
+        }
+
+        /*
+         * singular vectors of M
+         */
+        for (j = 0; j < k; j++) {
+            double su = 0.0, sv = 0.0;
+            double sj = dk[org[j]] + tau[j];
+
+            for (i = 0; i < k; i++) {
+                double vt = zk[i] / (((dk[i] - dk[org[j]]) - tau[j]) * (dk[i] + sj));
+
+                Vh[i][j] = vt;
+                Uh[i][j] = (i == 0) ? -1.0 : dk[i] * vt;
+                sv += vt * vt;
+                su += Uh[i][j] * Uh[i][j];
+            }
+            su = 1.0 / sqrt(su);
+            sv = 1.0 / sqrt(sv);
+            for (i = 0; i < k; i++) {
+                Uh[i][j] *= su;
+                Vh[i][j] *= sv;
+            }
+            d[j] = sj * orgnrm;
+        }
+
+        /*
+         * U = diag(U1, 1, U2).Uh, V = diag(V1, V2).Vh for the non-deflated
+         * columns; the deflated ones are carried over
+         */
+        for (r = 0; r < n; r++)
+            for (i = 0; i < k; i++)
+                G[r][i] = Ub[r][col[kidx[i]]];
+        matmul(n, k, k, G, Uh, P);
+        for (r = 0; r < n; r++) {
+            memcpy(U[r], P[r], k * sizeof(double));
+            for (i = 0; i < nd; i++)
+                U[r][k + i] = Ub[r][col[didx[i]]];
+        }
+        for (r = 0; r < nv; r++)
+            for (i = 0; i < k; i++)
+                G[r][i] = Vb[r][col[kidx[i]]];
+        matmul(nv, k, k, G, Vh, P);
+        for (r = 0; r < nv; r++) {
+            memcpy(V[r], P[r], k * sizeof(double));
+            for (i = 0; i < nd; i++)
+                V[r][k + i] = Vb[r][col[didx[i]]];
+            if (sqre)
+                V[r][n] = Vb[r][n];
+        }
+        for (i = 0; i < nd; i++)
+            d[k + i] = dd[didx[i]] * orgnrm;
+
+        free2d(Uh);
+        free2d(Vh);
+        free2d(G);
+        free2d(P);
+    }
+
+  out:
+    free2d(Ub);
+    free2d(Vb);
+    free(dd);
+    free(zz);
+    free(dk);
+    free(zk);
+    free(tau);
+    free(col);
+    free(kidx);
+    free(didx);
+    free(org);
+    free(se);
+}
+
+/* Recursive step of bdc() for an n x (n+sqre) upper bidiagonal matrix.
+ * The two halves are independent and are solved as parallel tasks.
+ */
+static void bdc_rec(int n, int sqre, double* d, double* e, double** U, double** V)
+{
+    int nl, nr;
+    double alpha, beta;
+    double** U1;
+    double** V1;
+    double** U2;
+    double** V2;
+
+    if (n <= SVD_DCLEAF) {
+        bdc_leaf(n, sqre, d, e, U, V);
+        return;
+    }
+
+    nl = n / 2;
+    nr = n - nl - 1;
+    alpha = d[nl];
+    beta = e[nl];
+    U1 = (double**)(alloc2d(nl, nl, sizeof(double)));
+    V1 = (double**)(alloc2d(nl + 1, nl + 1, sizeof(double)));
+    U2 = (double**)(alloc2d(nr, nr, sizeof(double)));
+    V2 = (double**)(alloc2d(nr + sqre, nr + sqre, sizeof(double)));
+
+#pragma omp task if (nl > SVD_DCTASK)
+    bdc_rec(nl, 1, d, e, U1, V1);
+#pragma omp task if (nr > SVD_DCTASK)
+    bdc_rec(nr, sqre, &d[nl + 1], &e[nl + 1], U2, V2);
+#pragma omp taskwait
+
+    bdc_merge(n, sqre, nl, alpha, beta, d, U1, V1, U2, V2, U, V);
+
+    free2d(U1);
+    free2d(V1);
+    free2d(U2);
+    free2d(V2);
+}
+
+/** Divide-and-conquer SVD of an upper bidiagonal matrix (as LAPACK's
+ * dbdsdc): B = U.diag(d).V'.
+ *
+ * @param n Order of the matrix
+ * @param d Input diagonal [0..n-1]; output singular values (not sorted)
+ * @param e Input superdiagonal [0..n-2] (e[i] = B[i][i+1]); destroyed
+ * @param U Output matrix [0..n-1][0..n-1]
+ * @param V Output matrix [0..n-1][0..n-1]
+ */
+void bdc(int n, double* d, double* e, double** U, double** V)
+{
+#pragma omp parallel
+#pragma omp single
+    bdc_rec(n, 0, d, e, U, V);
+}
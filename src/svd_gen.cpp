@@ -0,0 +1,181 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+
+#include "svd.hpp"
+#include "svd_internal.hpp"
+
+/* Draws a random reflector H = I - tau.v.v' of order n (v[0] = 1), the
+ * reflector that maps a Gaussian random vector to a multiple of e1. A
+ * product of such reflectors of orders n, n-1, ... is a random orthogonal
+ * matrix distributed according to the Haar measure (Stewart, 1980).
+ */
+static double random_reflector(int n, double* v, unsigned long long* state)
+{
+    double s = 0.0, beta, u0;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        v[i] = randn(state);
+        s += v[i] * v[i];
+    }
+    if (s == 0.0) {
+        v[0] = 1.0;
+        return 0.0;
+    }
+    beta = -copysign(sqrt(s), v[0]);
+    u0 = v[0] - beta;
+    for (i = 1; i < n; i++)
+        v[i] /= u0;
+    v[0] = 1.0;
+
+    return -u0 / beta;
+}
+
+/** Computes a singular value distribution, as the modes of LAPACK's
+ * dlatms. The first rank values follow the mode, from 1 down to 1/cond;
+ * the others are zero.
+ *
+ * @param k Number of singular values
+ * @param mode Distribution (SVD_SPEC_*)
+ * @param cond Condition number (of the first rank values), >= 1
+ * @param rank Number of nonzero values, or 0 for k
+ * @param seed Seed of the random number generator (SVD_SPEC_RANDOM)
+ * @param sigma Output vector [0..k-1] of singular values (decreasing)
+ */
+void svd_spectrum(int k, int mode, double cond, int rank, unsigned int seed, double* sigma)
+{
+    unsigned long long state = 0x9E3779B97F4A7C15ULL * ((unsigned long long) seed + 1);
+    int i;
+
+    if (cond < 1.0)
+        quit("svd_spectrum(): cond = %g; expected cond >= 1\n", cond);
+    if (rank <= 0 || rank > k)
+        rank = k;
+    state ^= state >> 31;
+
+    for (i = 0; i < rank; i++) {
+        double t = (rank > 1) ? (double) i / (rank - 1) : 0.0;
+
+        switch (mode) {
+        case SVD_SPEC_ONELARGE:
+            sigma[i] = (i == 0) ? 1.0 : 1.0 / cond;
+            break;
+        case SVD_SPEC_ONESMALL:
+            sigma[i] = (i == rank - 1 && rank > 1) ? 1.0 / cond : 1.0;
+            break;
+        case SVD_SPEC_GEOMETRIC:
+            sigma[i] = pow(cond, -t);
+            break;
+        case SVD_SPEC_ARITHMETIC:
+            sigma[i] = 1.0 - t * (1.0 - 1.0 / cond);
+            break;
+        case SVD_SPEC_RANDOM:
+            sigma[i] = exp(-0.5 * (randu(&state) + 1.0) * log(cond));
+            break;
+        default:
+            quit("svd_spectrum(): unknown mode %d\n", mode);
+        }
+    }
+    for (i = rank; i < k; i++)
+        sigma[i] = 0.0;
+
+    if (mode == SVD_SPEC_RANDOM) {
+        /*
+         * the extremes are those of the other modes; the rest in
+         * decreasing order
+         */
+        for (i = 1; i < rank; i++) {
+            double x = sigma[i];
+            int j;
+
+            for (j = i; j > 0 && sigma[j - 1] < x; j--)
+                sigma[j] = sigma[j - 1];
+            sigma[j] = x;
+        }
+        if (rank > 0)
+            sigma[0] = 1.0;
+        if (rank > 1)
+            sigma[rank - 1] = 1.0 / cond;
+    }
+}
+
+/** Generates a test matrix with prescribed singular values, A = U.S.V',
+ * with U and V random orthogonal (Haar), as LAPACK's dlagge.
+ *
+ * S is set on the diagonal of A and, for i = k-1 down to 0, random
+ * reflectors of orders m - i and n - i are applied to the trailing block
+ * A[i..m-1][i..n-1] from the left and from the right. This costs about
+ * 8n^3/3 operations for m = n, and no storage beyond A.
+ *
+ * With graded set, the orthogonal factor of the shorter dimension is the
+ * identity: the columns (m >= n) or rows (m < n) of A are orthogonal with
+ * norms sigma, and are graded if sigma is.
+ *
+ * @param A Output matrix A [0..m-1][0..n-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param sigma Input vector [0..k-1] of singular values, k = min(m,n)
+ * @param graded Whether the shorter factor is the identity
+ * @param seed Seed of the random number generator
+ */
+void svd_gen(double** A, int n, int m, const double* sigma, int graded, unsigned int seed)
+{
+    unsigned long long state = 0x9E3779B97F4A7C15ULL * ((unsigned long long) seed + 1);
+    int k = (m < n) ? m : n;
+    double* v = (double*)(malloc(((m > n) ? m : n) * sizeof(double)));
+    double* s = (double*)(malloc(n * sizeof(double)));
+    int i, j, r;
+
+    state ^= state >> 31;
+    for (i = 0; i < m; i++)
+        memset(A[i], 0, n * sizeof(double));
+    for (i = 0; i < k; i++)
+        A[i][i] = sigma[i];
+
+    for (i = k - 1; i >= 0; i--) {
+        double tau;
+
+        /*
+         * A[i:m][i:n] = H.A[i:m][i:n]
+         */
+        if (!(graded && m < n) && (tau = random_reflector(m - i, v, &state)) != 0.0) {
+            for (j = i; j < n; j++)
+                s[j] = 0.0;
+            for (r = i; r < m; r++) {
+                double vr = v[r - i];
+                double* a = A[r];
+
+                for (j = i; j < n; j++)
+                    s[j] += vr * a[j];
+            }
+            for (r = i; r < m; r++) {
+                double vr = tau * v[r - i];
+                double* a = A[r];
+
+                for (j = i; j < n; j++)
+                    a[j] -= vr * s[j];
+            }
+        }
+
+        /*
+         * A[i:m][i:n] = A[i:m][i:n].H
+         */
+        if (!(graded && m >= n) && (tau = random_reflector(n - i, v, &state)) != 0.0) {
+            for (r = i; r < m; r++) {
+                double* a = &A[r][i];
+                double t = 0.0;
+
+                for (j = 0; j < n - i; j++)
+                    t += a[j] * v[j];
+                t *= tau;
+                for (j = 0; j < n - i; j++)
+                    a[j] -= t * v[j];
+            }
+        }
+    }
+
+    free(v);
+    free(s);
+}
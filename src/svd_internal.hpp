@@ -0,0 +1,96 @@
+#if !defined(_SVD_INTERNAL_H)
+#define _SVD_INTERNAL_H
+
+#include "svd.hpp"
+
+#define SVD_EPS 18              /* singular values below SVD_EPS.eps relative to
+                                 * the largest are zeroed by svd_sort() */
+#define SVD_DCLEAF 25           /* largest subproblem of bdc() that is solved
+                                 * by the QR sweep */
+#define SVD_LANES 8             /* matrices decomposed together by svd_soa() */
+#define SVD_SOAMAX 8            /* largest dimension handled by svd_soa() */
+#define SVD_RCB 64              /* panel width of rot_seq() */
+#define SVD_RAWMAGIC "SVDMAT01" /* first 8 bytes of a raw matrix file */
+#define SVD_RAWHDR 24           /* bytes in the header of a raw matrix file:
+                                 * magic, rows and columns (int64) */
+#define SVD_TXTCHUNK 1048576    /* smallest chunk of a text matrix file
+                                 * parsed by one thread */
+
+/*
+ * Vector kernels are compiled for several instruction sets and the best one
+ * is picked at load time; their inner loops are marked for vectorisation
+ * (honoured with -fopenmp or -fopenmp-simd, see CMakeLists.txt).
+ */
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(__clang__)
+#define SVD_CLONES __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+#else
+#define SVD_CLONES
+#endif
+#define SVD_SIMD _Pragma("omp simd")
+
+/* Shared by the translation units of the library; see svd.cpp. */
+
+void quit(const char* format, ...);
+
+template <typename T>
+void matmul(int m, int n, int k, T** A, T** B, T** C);
+
+template <typename T>
+T householder(int n, T* x, T* tau, T* u0);
+
+template <typename T>
+void bidiag_qr(int n, T* w, T* rv1, T tst1, T** U, int m, T** V, int nv, int nthreads);
+
+template <typename T>
+void svd_small(T** A, int n, int m, T* w, T** V, T* rv1);
+
+double randu(unsigned long long* state);
+
+double randn(unsigned long long* state);
+
+double reorth(int n, double* x, double** X, int j);
+
+void randvec(int n, double* x, double** X, int j, unsigned long long* state);
+
+/* Divide-and-conquer SVD of an upper bidiagonal matrix; see svd_dc.cpp. */
+void bdc(int n, double* d, double* e, double** U, double** V);
+
+/* One-sided Jacobi SVD of a matrix with m >= n; see svd_jacobi.cpp. */
+void jacobi(double** A, int n, int m, double* w, double** V);
+
+/* SVD of SVD_LANES small matrices at once, vectorised across matrices; see
+ * svd_soa.cpp. */
+void svd_soa(int n, int m, double** A, double** w, double** V);
+
+/* Plane rotations of contiguous vectors; see svd_rot.cpp. */
+template <typename T>
+struct givens {
+    int p, q;
+    T c, s;
+};
+
+template <typename T>
+void rot_seq(int nrot, const givens<T>* g, int n, int nr, T* P, int nthreads);
+
+/* Matrix files of the svd executable; see svd_io.cpp. */
+struct matfile {
+    void* map;                  /* binary file mapping, or NULL */
+    size_t size;
+    int n, m;
+    double** A;                 /* rows, in the mapping or from alloc2d() */
+    const char* out;            /* name of a file created for output */
+};
+
+int matfile_map(const char* fname, struct matfile* mf);
+
+void matfile_text(const char* fname, struct matfile* mf);
+
+void matfile_open(const char* fname, struct matfile* mf);
+
+void matfile_create(const char* fname, int n, int m, struct matfile* mf);
+
+void matfile_write(const char* fname, int n, int m, int vec, double** A);
+
+void matfile_close(struct matfile* mf);
+
+#endif
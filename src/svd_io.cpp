@@ -0,0 +1,530 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#if __cplusplus >= 201703L
+#include <charconv>
+#endif
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "svd.hpp"
+#include "svd_internal.hpp"
+
+/* Row pointers of the m x n row-major doubles at data. */
+static double** rows(double* data, int n, int m)
+{
+    double** A = (double**)(malloc(m * sizeof(double*)));
+    int i;
+
+    if (A == NULL)
+        quit("could not allocate %d row pointers\n", m);
+    for (i = 0; i < m; i++)
+        A[i] = data + (size_t) i * n;
+
+    return A;
+}
+
+/* Reads the dimensions in the header of a raw matrix file.
+ * @return Offset of the data, or 0 if this is not a raw matrix file
+ */
+static size_t raw_header(const char* fname, const unsigned char* p, size_t size, int* n, int* m)
+{
+    int64_t mm, nn;
+
+    if (size < SVD_RAWHDR || memcmp(p, SVD_RAWMAGIC, 8) != 0)
+        return 0;
+    memcpy(&mm, p + 8, 8);
+    memcpy(&nn, p + 16, 8);
+    if (mm <= 0 || nn <= 0 || mm > INT32_MAX || nn > INT32_MAX)
+        quit("%s: bad dimensions %lld x %lld\n", fname, (long long) mm, (long long) nn);
+    *m = (int) mm;
+    *n = (int) nn;
+
+    return SVD_RAWHDR;
+}
+
+/* Value of key in the dictionary of a .npy header, or NULL. */
+static const char* npy_value(const char* hdr, const char* key)
+{
+    const char* s = strstr(hdr, key);
+
+    if (s == NULL || (s = strchr(s + strlen(key), ':')) == NULL)
+        return NULL;
+    for (s++; *s == ' '; s++);
+
+    return s;
+}
+
+/* Reads the dimensions in the header of a NumPy .npy file; the array must
+ * be 1- or 2-dimensional, little-endian float64 and in C order.
+ * @return Offset of the data, or 0 if this is not a .npy file
+ */
+static size_t npy_header(const char* fname, const unsigned char* p, size_t size, int* n, int* m)
+{
+    char hdr[1024];
+    size_t len, off;
+    const char* s;
+    long long dims[3], d0, d1;
+    int ndim;
+
+    if (size < 10 || memcmp(p, "\x93NUMPY", 6) != 0)
+        return 0;
+    if (p[6] == 1) {
+        len = p[8] | (p[9] << 8);
+        off = 10;
+    } else {
+        if (size < 12)
+            quit("%s: truncated .npy header\n", fname);
+        len = p[8] | (p[9] << 8) | ((size_t) p[10] << 16) | ((size_t) p[11] << 24);
+        off = 12;
+    }
+    if (len >= sizeof(hdr) || off + len > size)
+        quit("%s: bad .npy header\n", fname);
+    memcpy(hdr, p + off, len);
+    hdr[len] = 0;
+
+    if ((s = npy_value(hdr, "'descr'")) == NULL || strncmp(s, "'<f8'", 5) != 0)
+        quit("%s: expected a little-endian float64 array ('<f8')\n", fname);
+    if ((s = npy_value(hdr, "'fortran_order'")) == NULL || strncmp(s, "False", 5) != 0)
+        quit("%s: expected a C-order array (fortran_order False)\n", fname);
+    if ((s = npy_value(hdr, "'shape'")) == NULL || *s != '(')
+        quit("%s: bad .npy shape\n", fname);
+    for (s++, ndim = 0; ndim < 3; ndim++) {
+        char* end;
+        long long d = strtoll(s, &end, 10);
+
+        if (end == s)
+            break;
+        dims[ndim] = d;
+        for (s = end; *s == ' ' || *s == ','; s++);
+    }
+    if (*s != ')' || ndim < 1 || ndim > 2)
+        quit("%s: expected a 1- or 2-dimensional array\n", fname);
+    d0 = dims[0];
+    d1 = (ndim == 2) ? dims[1] : 1;
+    if (d0 <= 0 || d1 <= 0 || d0 > INT32_MAX || d1 > INT32_MAX)
+        quit("%s: bad dimensions %lld x %lld\n", fname, d0, d1);
+    *m = (int) d0;
+    *n = (int) d1;
+
+    return off + len;
+}
+
+/* Maps the whole of an open file privately (copy on write), or reads it
+ * into memory where mmap() is not available.
+ */
+static void* map_file(const char* fname, FILE* f, size_t* size)
+{
+    void* map;
+
+#if !defined(_WIN32)
+    struct stat st;
+
+    if (fstat(fileno(f), &st) != 0)
+        quit("%s: %s\n", fname, strerror(errno));
+    *size = (size_t) st.st_size;
+    if (*size == 0)
+        return NULL;
+    map = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(f), 0);
+    if (map == MAP_FAILED)
+        quit("%s: mmap: %s\n", fname, strerror(errno));
+#else
+    if (fseek(f, 0, SEEK_END) != 0 || (*size = (size_t) ftell(f)) == (size_t) -1 || fseek(f, 0, SEEK_SET) != 0)
+        quit("%s: %s\n", fname, strerror(errno));
+    if (*size == 0)
+        return NULL;
+    map = malloc(*size);
+    if (map == NULL)
+        quit("%s: could not allocate %zu bytes\n", fname, *size);
+    if (fread(map, 1, *size, f) != *size)
+        quit("%s: read error\n", fname);
+#endif
+
+    return map;
+}
+
+static void unmap_file(void* map, size_t size)
+{
+    if (map == NULL)
+        return;
+#if !defined(_WIN32)
+    munmap(map, size);
+#else
+    (void) size;
+    free(map);
+#endif
+}
+
+/* Text matrix files: one row per line, values separated by white space,
+ * commas or semicolons. */
+
+static int is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static int is_sep(char c)
+{
+    return is_space(c) || c == ',' || c == ';';
+}
+
+/* Parses a number at p (before end) into *x; returns the end of the number,
+ * or NULL if there is none.
+ */
+static const char* parse_value(const char* p, const char* end, double* x)
+{
+    if (p < end && *p == '+')
+        p++;
+#if defined(__cpp_lib_to_chars)
+    {
+        std::from_chars_result r = std::from_chars(p, end, *x);
+
+        if (r.ec == std::errc::invalid_argument)
+            return NULL;
+        if (r.ec == std::errc::result_out_of_range) {
+            /*
+             * from_chars() leaves x unset; underflow goes to 0, overflow to
+             * infinity, as with strtod()
+             */
+            char buf[64];
+            size_t len = (size_t) (r.ptr - p);
+
+            if (len >= sizeof(buf))
+                return NULL;
+            memcpy(buf, p, len);
+            buf[len] = 0;
+            *x = strtod(buf, NULL);
+        }
+        return r.ptr;
+    }
+#else
+    {
+        char buf[64];
+        char* e;
+        size_t len = 0;
+
+        while (p + len < end && len < sizeof(buf) - 1 && !is_sep(p[len]) && p[len] != '\n')
+            len++;
+        memcpy(buf, p, len);
+        buf[len] = 0;
+        *x = strtod(buf, &e);
+        return (e == buf) ? NULL : p + (e - buf);
+    }
+#endif
+}
+
+/* Start of the line after the one at p, or end. */
+static const char* next_line(const char* p, const char* end)
+{
+    const char* q = (const char*) memchr(p, '\n', end - p);
+
+    return (q == NULL) ? end : q + 1;
+}
+
+/* Whether the line at p contains only separators. */
+static int is_blank(const char* p, const char* end)
+{
+    while (p < end && *p != '\n' && is_sep(*p))
+        p++;
+
+    return p == end || *p == '\n';
+}
+
+/* Parses the line at p into x [0..n-1] (or only counts the values if x is
+ * NULL, n is then ignored).
+ * @return Number of values, or -1 on a syntax error or if the line has
+ *         more than n values
+ */
+static int parse_line(const char* p, const char* end, int n, double* x)
+{
+    double tmp;
+    int k = 0;
+
+    for (;;) {
+        while (p < end && is_sep(*p))
+            p++;
+        if (p == end || *p == '\n')
+            return k;
+        if (x != NULL && k == n)
+            return -1;
+        if ((p = parse_value(p, end, (x != NULL) ? &x[k] : &tmp)) == NULL)
+            return -1;
+        k++;
+        if (p < end && *p != '\n' && !is_sep(*p))
+            return -1;
+    }
+}
+
+/** Reads a text matrix file: one row per line, values separated by white
+ * space, commas or semicolons, blank lines ignored. A first line that does
+ * not start with a number (a CSV header) is skipped.
+ *
+ * The file is mapped and split into chunks at line boundaries, which are
+ * parsed in parallel (OpenMP) straight into the rows of the matrix: a
+ * first pass counts the rows of each chunk, a second parses them, with
+ * std::from_chars() where the library has it for doubles.
+ *
+ * @param fname File name
+ * @param mf Output matrix; mf->A [0..m-1][0..n-1] is allocated by alloc2d()
+ */
+void matfile_text(const char* fname, struct matfile* mf)
+{
+    FILE* f = fopen(fname, "rb");
+    const char* data;
+    const char* end;
+    const char* p;
+    const char** cstart;
+    int* crows;
+    size_t size;
+    int nchunks, c;
+    int nthreads = 1;
+
+    memset(mf, 0, sizeof(*mf));
+    if (f == NULL)
+        quit("%s: %s\n", fname, strerror(errno));
+    data = (const char*) map_file(fname, f, &size);
+    fclose(f);
+    end = data + size;
+
+    /*
+     * header, and the number of columns from the first row
+     */
+    for (p = data; p < end && is_blank(p, end); p = next_line(p, end));
+    if (p < end) {
+        const char* q = p;
+
+        while (is_sep(*q))
+            q++;
+        if (!((*q >= '0' && *q <= '9') || *q == '.' || *q == '-' || *q == '+'))
+            for (p = next_line(p, end); p < end && is_blank(p, end); p = next_line(p, end));
+    }
+    if (p == end)
+        quit("%s: no data\n", fname);
+    if ((mf->n = parse_line(p, end, 0, NULL)) <= 0)
+        quit("%s: could not parse the first row\n", fname);
+
+    /*
+     * chunks of at least SVD_TXTCHUNK bytes, a few per thread
+     */
+#if defined(_OPENMP)
+    nthreads = omp_get_max_threads();
+#endif
+    nchunks = (int) ((end - p) / SVD_TXTCHUNK) + 1;
+    if (nchunks > 4 * nthreads)
+        nchunks = 4 * nthreads;
+    cstart = (const char**)(malloc((nchunks + 1) * sizeof(char*)));
+    crows = (int*)(malloc((nchunks + 1) * sizeof(int)));
+    cstart[0] = p;
+    for (c = 1; c < nchunks; c++) {
+        const char* q = p + (size_t) (end - p) / nchunks * c;
+
+        if (q < cstart[c - 1])
+            q = cstart[c - 1];
+        cstart[c] = (q == p) ? p : next_line(q - 1, end);
+    }
+    cstart[nchunks] = end;
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (c = 0; c < nchunks; c++) {
+        int nr = 0;
+
+        for (const char* q = cstart[c]; q < cstart[c + 1]; q = next_line(q, end))
+            if (!is_blank(q, end))
+                nr++;
+        crows[c] = nr;
+    }
+    for (c = 0, mf->m = 0; c < nchunks; c++) {
+        int nr = crows[c];
+
+        if (mf->m > INT32_MAX - nr)
+            quit("%s: too many rows\n", fname);
+        crows[c] = mf->m;
+        mf->m += nr;
+    }
+    crows[nchunks] = mf->m;
+
+    mf->A = (double**)(alloc2d(mf->n, mf->m, sizeof(double)));
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (c = 0; c < nchunks; c++) {
+        int r = crows[c];
+
+        for (const char* q = cstart[c]; q < cstart[c + 1]; q = next_line(q, end)) {
+            if (is_blank(q, end))
+                continue;
+            if (parse_line(q, end, mf->n, mf->A[r]) != mf->n)
+                quit("%s: row %d: expected %d numbers\n", fname, r + 1, mf->n);
+            r++;
+        }
+    }
+
+    free(cstart);
+    free(crows);
+    unmap_file((void*) data, size);
+}
+
+/** Maps a binary matrix file into memory: either a raw file (SVD_RAWMAGIC,
+ * then the numbers of rows and columns as 64-bit integers, then the rows
+ * as doubles) or a NumPy .npy file of float64 in C order. The mapping is
+ * private: the matrix can be overwritten (e.g. by svd()) and only the pages
+ * written to are copied; the file is not modified.
+ *
+ * @param fname File name
+ * @param mf Output matrix; mf->A [0..m-1][0..n-1] points into the mapping
+ * @return 1 if the file was mapped, 0 if it is not a binary matrix file
+ */
+int matfile_map(const char* fname, struct matfile* mf)
+{
+    unsigned char head[1036];
+    size_t hlen, off;
+    FILE* f = fopen(fname, "rb");
+
+    memset(mf, 0, sizeof(*mf));
+    if (f == NULL)
+        quit("%s: %s\n", fname, strerror(errno));
+    hlen = fread(head, 1, sizeof(head), f);
+    if ((off = raw_header(fname, head, hlen, &mf->n, &mf->m)) == 0 && (off = npy_header(fname, head, hlen, &mf->n, &mf->m)) == 0) {
+        fclose(f);
+        return 0;
+    }
+    if (off % sizeof(double) != 0)
+        quit("%s: misaligned data\n", fname);
+    mf->map = map_file(fname, f, &mf->size);
+    fclose(f);
+    if (mf->size < off + (size_t) mf->m * mf->n * sizeof(double))
+        quit("%s: truncated: %zu bytes, expected %zu\n", fname, mf->size, off + (size_t) mf->m * mf->n * sizeof(double));
+    mf->A = rows((double*) ((char*) mf->map + off), mf->n, mf->m);
+
+    return 1;
+}
+
+/* Writes the header of a binary matrix file for m x n doubles into buf
+ * [0..127]: .npy if the name ends in ".npy" (a 1-dimensional array of n
+ * if vec), raw otherwise.
+ * @return Length of the header, a multiple of 64 for .npy (as NumPy pads
+ *         it) so that the data is aligned
+ */
+static size_t make_header(const char* fname, int n, int m, int vec, char* buf)
+{
+    size_t len = strlen(fname);
+    int64_t mm = m, nn = n;
+    int hl;
+
+    if (len < 4 || strcmp(fname + len - 4, ".npy") != 0) {
+        memcpy(buf, SVD_RAWMAGIC, 8);
+        memcpy(buf + 8, &mm, 8);
+        memcpy(buf + 16, &nn, 8);
+        return SVD_RAWHDR;
+    }
+    memcpy(buf, "\x93NUMPY\x01\x00", 8);
+    if (vec)
+        hl = sprintf(buf + 10, "{'descr': '<f8', 'fortran_order': False, 'shape': (%d,), }", n);
+    else
+        hl = sprintf(buf + 10, "{'descr': '<f8', 'fortran_order': False, 'shape': (%d, %d), }", m, n);
+    while ((10 + hl + 1) % 64 != 0)
+        buf[10 + hl++] = ' ';
+    buf[10 + hl++] = '\n';
+    buf[8] = (char) (hl & 0xff);
+    buf[9] = (char) (hl >> 8);
+
+    return 10 + hl;
+}
+
+/** Writes a matrix A [0..m-1][0..n-1] to a binary matrix file, .npy if the
+ * name ends in ".npy", raw otherwise; as a 1-dimensional .npy array if vec
+ * (m = 1).
+ */
+void matfile_write(const char* fname, int n, int m, int vec, double** A)
+{
+    char head[128];
+    size_t hl = make_header(fname, n, m, vec, head);
+    FILE* f = fopen(fname, "wb");
+    int i;
+
+    if (f == NULL)
+        quit("%s: %s\n", fname, strerror(errno));
+    if (fwrite(head, 1, hl, f) != hl)
+        quit("%s: write error\n", fname);
+    for (i = 0; i < m; i++)
+        if (fwrite(A[i], sizeof(double), n, f) != (size_t) n)
+            quit("%s: write error\n", fname);
+    if (fclose(f) != 0)
+        quit("%s: %s\n", fname, strerror(errno));
+}
+
+/** Creates a binary matrix file (see matfile_write()) for m x n doubles
+ * and maps it, shared: the rows mf->A can be passed to the decomposition
+ * as an output and end up in the file without a further copy. Released
+ * (and written) by matfile_close().
+ */
+void matfile_create(const char* fname, int n, int m, struct matfile* mf)
+{
+    char head[128];
+    size_t hl = make_header(fname, n, m, 0, head);
+
+    memset(mf, 0, sizeof(*mf));
+    mf->n = n;
+    mf->m = m;
+    mf->size = hl + (size_t) m * n * sizeof(double);
+    mf->out = fname;
+#if !defined(_WIN32)
+    {
+        int fd = open(fname, O_RDWR | O_CREAT | O_TRUNC, 0666);
+
+        if (fd < 0)
+            quit("%s: %s\n", fname, strerror(errno));
+        if (ftruncate(fd, (off_t) mf->size) != 0)
+            quit("%s: %s\n", fname, strerror(errno));
+        mf->map = mmap(NULL, mf->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mf->map == MAP_FAILED)
+            quit("%s: mmap: %s\n", fname, strerror(errno));
+        close(fd);
+    }
+#else
+    mf->map = calloc(mf->size, 1);
+    if (mf->map == NULL)
+        quit("%s: could not allocate %zu bytes\n", fname, mf->size);
+#endif
+    memcpy(mf->map, head, hl);
+    mf->A = rows((double*) ((char*) mf->map + hl), n, m);
+}
+
+/** Reads a matrix file, binary (matfile_map()) or text (matfile_text()). */
+void matfile_open(const char* fname, struct matfile* mf)
+{
+    if (!matfile_map(fname, mf))
+        matfile_text(fname, mf);
+}
+
+/** Releases a matrix read by matfile_open() or created by
+ * matfile_create(). */
+void matfile_close(struct matfile* mf)
+{
+    if (mf->out != NULL) {
+#if !defined(_WIN32)
+        if (msync(mf->map, mf->size, MS_SYNC) != 0)
+            quit("%s: %s\n", mf->out, strerror(errno));
+#else
+        FILE* f = fopen(mf->out, "wb");
+
+        if (f == NULL || fwrite(mf->map, 1, mf->size, f) != mf->size || fclose(f) != 0)
+            quit("%s: write error\n", mf->out);
+#endif
+        unmap_file(mf->map, mf->size);
+        free(mf->A);
+    } else if (mf->map != NULL) {
+        unmap_file(mf->map, mf->size);
+        free(mf->A);
+    } else
+        free2d(mf->A);
+    memset(mf, 0, sizeof(*mf));
+}
@@ -0,0 +1,186 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <float.h>
+
+#include "svd.hpp"
+#include "svd_internal.hpp"
+
+#define SVD_JMAXSWEEP 40        /* sweeps of the one-sided Jacobi method */
+#define SVD_JPAR 65536          /* smallest matrix (elements) for which the
+                                 * rotations of a step run in parallel */
+
+/* Orthogonalises a pair of rows of G, applying the same rotation to the rows
+ * of Vt (if not NULL). A row whose squared norm is at most small holds only
+ * rounding errors and is not rotated.
+ * @return 1 if the rows were rotated, 0 if they were already orthogonal to
+ *         the working accuracy
+ */
+static int jacobi_pair(double** G, int m, double** Vt, int n, int p, int q, double tol, double small)
+{
+    double* gp = G[p];
+    double* gq = G[q];
+    double alpha = 0.0, beta = 0.0, gamma = 0.0;
+    double zeta, t, c, s;
+    int i;
+
+    for (i = 0; i < m; i++) {
+        alpha += gp[i] * gp[i];
+        beta += gq[i] * gq[i];
+        gamma += gp[i] * gq[i];
+    }
+    if (alpha <= small || beta <= small || fabs(gamma) <= tol * sqrt(alpha) * sqrt(beta))
+        return 0;
+
+    zeta = (beta - alpha) / (2.0 * gamma);
+    t = copysign(1.0, zeta) / (fabs(zeta) + sqrt(1.0 + zeta * zeta));
+    c = 1.0 / sqrt(1.0 + t * t);
+    s = c * t;
+
+    for (i = 0; i < m; i++) {
+        double x = gp[i];
+        double y = gq[i];
+
+        gp[i] = c * x - s * y;
+        gq[i] = s * x + c * y;
+    }
+    if (Vt != NULL) {
+        double* vp = Vt[p];
+        double* vq = Vt[q];
+
+        for (i = 0; i < n; i++) {
+            double x = vp[i];
+            double y = vq[i];
+
+            vp[i] = c * x - s * y;
+            vq[i] = s * x + c * y;
+        }
+    }
+    return 1;
+}
+
+/** One-sided (Hestenes) Jacobi SVD of an m x n matrix, m >= n.
+ *
+ * The columns of A are made mutually orthogonal by plane rotations from the
+ * right, A.V = U.W. The columns are kept as rows of a transposed copy so that
+ * they are contiguous. Each sweep visits all pairs in round-robin order: a
+ * step is a set of n/2 disjoint pairs whose rotations are independent and
+ * are applied in parallel. Pairs are rotated while their cosine exceeds
+ * sqrt(m).eps, which makes the singular values accurate to high relative
+ * accuracy also for graded matrices. As in LAPACK's dgesvj, a column whose
+ * norm is at most eps times the largest column norm of A is taken as
+ * rounding noise: it is not rotated, and its column of U is completed like
+ * that of a null singular value.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]; output matrix U [0..m-1][0..n-1]
+ *          (destroyed if V is NULL)
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Ouput vector [0..n-1] of singular values (not sorted)
+ * @param V Output matrix V [0..n-1][0..n-1] or NULL for singular values only
+ */
+void jacobi(double** A, int n, int m, double* w, double** V)
+{
+    double** G = (double**)(alloc2d(m, n, sizeof(double)));
+    double** Vt = NULL;
+    int np = n + (n % 2);       /* a dummy column n pads odd n */
+    int* pos = (int*)(malloc(np * sizeof(int)));
+    double tol = sqrt((double) m) * DBL_EPSILON;
+    double small = 0.0;
+    int i, j, sweep, step, rotated = 1;
+
+    for (i = 0; i < m; i++)
+        for (j = 0; j < n; j++)
+            G[j][i] = A[i][j];
+    for (j = 0; j < n; j++) {
+        double s = 0.0;
+
+        for (i = 0; i < m; i++)
+            s += G[j][i] * G[j][i];
+        small = fmax(small, s);
+    }
+    small *= DBL_EPSILON * DBL_EPSILON;
+    if (V != NULL) {
+        Vt = (double**)(alloc2d(n, n, sizeof(double)));
+        for (j = 0; j < n; j++)
+            Vt[j][j] = 1.0;
+    }
+    for (i = 0; i < np; i++)
+        pos[i] = i;
+
+    for (sweep = 0; sweep < SVD_JMAXSWEEP && rotated; sweep++) {
+        rotated = 0;
+        for (step = 0; step < np - 1; step++) {
+            int last;
+
+#pragma omp parallel for reduction(+:rotated) if ((double) m * n >= SVD_JPAR)
+            for (i = 0; i < np / 2; i++) {
+                int p = pos[i];
+                int q = pos[np - 1 - i];
+
+                if (p < n && q < n)
+                    rotated += jacobi_pair(G, m, Vt, n, (p < q) ? p : q, (p < q) ? q : p, tol, small);
+            }
+
+            /*
+             * round-robin: pos[0] stays, the others move by one place
+             */
+            last = pos[np - 1];
+            memmove(&pos[2], &pos[1], (np - 2) * sizeof(int));
+            pos[1] = last;
+        }
+    }
+    if (rotated)
+        quit("svd_jacobi(): no convergence in %d sweeps\n", SVD_JMAXSWEEP);
+    if (svd_verbose) {
+        fprintf(stderr, "  svd: one-sided Jacobi: %d sweeps\n", sweep);
+        fflush(stderr);
+    }
+
+    for (j = 0; j < n; j++) {
+        double s = 0.0;
+
+        for (i = 0; i < m; i++)
+            s += G[j][i] * G[j][i];
+        w[j] = sqrt(s);
+    }
+    if (V != NULL) {
+        double** X = (double**)(malloc(n * sizeof(double*)));
+        unsigned long long state = 0x9E3779B97F4A7C15ULL;
+        int nx = 0;
+
+        /*
+         * noise columns were left alone and need not be orthogonal to the
+         * others; the margin allows for the rounding of their norms
+         */
+        for (j = 0; j < n; j++)
+            if (w[j] > DBL_MIN && w[j] * w[j] > 4.0 * small) {
+                double f = 1.0 / w[j];
+
+                for (i = 0; i < m; i++)
+                    G[j][i] *= f;
+                X[nx++] = G[j];
+            }
+        /*
+         * the columns of null singular values are completed to an
+         * orthonormal set, as by svd()
+         */
+        for (j = 0; j < n; j++)
+            if (!(w[j] > DBL_MIN && w[j] * w[j] > 4.0 * small)) {
+                randvec(m, G[j], X, nx, &state);
+                X[nx++] = G[j];
+            }
+        for (i = 0; i < m; i++)
+            for (j = 0; j < n; j++)
+                A[i][j] = G[j][i];
+        for (i = 0; i < n; i++)
+            for (j = 0; j < n; j++)
+                V[i][j] = Vt[j][i];
+        free(X);
+        free2d(Vt);
+    }
+
+    free(pos);
+    free2d(G);
+}
@@ -0,0 +1,390 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <errno.h>
+#include <float.h>
+
+#include "svd.hpp"
+#include "svd_internal.hpp"
+
+static void usage()
+{
+    printf("Usage: svd <ncolumns> <nrows> <a_11> <a_12> ... <a_mn>\n");
+    printf("       svd -f <file> [-U <file>] [-W <file>] [-V <file>]\n");
+    printf("       svd -s <ncolumns> <file> [<ufile>]\n");
+    printf("       svd -g <ncolumns> <nrows> <mode> <cond> <file> [-r <rank>] [-G]\n");
+    printf("           [-S <seed>]\n");
+    printf("  -f  reads the matrix from a file: binary files, raw (\"%s\", rows\n", SVD_RAWMAGIC);
+    printf("      and columns as int64, row-major doubles) or NumPy .npy (float64,\n");
+    printf("      C order), are memory-mapped and decomposed in place; other files\n");
+    printf("      are read as text, a row per line, values separated by spaces,\n");
+    printf("      commas or semicolons. Prints the singular values, or writes them\n");
+    printf("      (-W), U (-U) and V (-V) to binary files, .npy if the name ends in\n");
+    printf("      .npy, raw otherwise; U and V are decomposed in the mapped files\n");
+    printf("  -s  out-of-core mode for a tall matrix: reads the rows from <file>\n");
+    printf("      (whitespace-separated text), prints W and V, and writes U to\n");
+    printf("      <ufile> if given\n");
+    printf("  -g  generates a test matrix U.S.V' with random orthogonal U and V and\n");
+    printf("      singular values S from 1 down to 1/cond (as LAPACK's dlatms),\n");
+    printf("      written as -f reads it: <mode> 1 = one large, 2 = one small,\n");
+    printf("      3 = geometric, 4 = arithmetic, 5 = random (log-uniform); -r\n");
+    printf("      zeroes all but <rank> values; -G makes the factor of the shorter\n");
+    printf("      side the identity (graded columns or rows)\n");
+    printf("E.g.:\n");
+    printf("  ./svd 4 3 1 0 0 1 -1 0 2 1 1 2 0 1\n");
+    printf("  ./svd 3 4 1 0 0 1 -1 0 2 1 1 2 0 1\n");
+    printf("  ./svd -f a.npy\n");
+    printf("  ./svd -f a.csv\n");
+    printf("  ./svd -f a.npy -U u.npy -W w.npy -V v.npy\n");
+    printf("  ./svd -s 300 a.txt u.txt\n");
+    printf("  ./svd -g 500 500 3 1e12 a.npy\n");
+    exit(0);
+}
+
+static void matrix_print(int n, int m, double** A, const char* offset)
+{
+    int i, j;
+
+    for (j = 0; j < m; ++j) {
+        printf("%s", offset);
+        for (i = 0; i < n; ++i)
+            printf("%10.5g ", fabs(A[j][i]) < SVD_EPS * DBL_EPSILON ? 0.0 : A[j][i]);
+        printf("\n");
+    }
+}
+
+struct textfile {
+    FILE* f;
+    const char* fname;
+    int nrows;
+};
+
+/* svd_rowsource of a text file with whitespace-separated values. */
+static int text_read(void* p, int nr, int n, double** X)
+{
+    struct textfile* tf = (struct textfile*) p;
+    int r, j, c;
+
+    if (nr == 0) {
+        tf->nrows = 0;
+        return fseek(tf->f, 0, SEEK_SET) == 0 ? 0 : -1;
+    }
+    for (r = 0; r < nr; r++) {
+        for (j = 0; j < n; j++) {
+            if ((c = fscanf(tf->f, "%lf", &X[r][j])) != 1) {
+                if (c == EOF && j == 0)
+                    return r;
+                quit("%s: row %d: could not read value %d\n", tf->fname, tf->nrows + 1, j + 1);
+            }
+        }
+        tf->nrows++;
+    }
+
+    return nr;
+}
+
+/* svd_rowsink of a text file. */
+static void text_write(void* p, int nr, int n, double** X)
+{
+    struct textfile* tf = (struct textfile*) p;
+    int r, j;
+
+    for (r = 0; r < nr; r++)
+        for (j = 0; j < n; j++)
+            fprintf(tf->f, "%.17g%c", X[r][j], (j < n - 1) ? ' ' : '\n');
+    if (ferror(tf->f))
+        quit("%s: write error\n", tf->fname);
+}
+
+/* svd -s <ncolumns> <file> [<ufile>] */
+static int main_stream(int argc, char* argv[])
+{
+    struct textfile in, out;
+    double** V = NULL;
+    double* w = NULL;
+    double** W = NULL;
+    int m, n, i;
+
+    if (argc != 4 && argc != 5)
+        usage();
+
+    n = atoi(argv[2]);
+    if (n <= 0)
+        quit("n = %d; expected n > 0\n", n);
+
+    in.fname = argv[3];
+    in.nrows = 0;
+    in.f = fopen(in.fname, "r");
+    if (in.f == NULL)
+        quit("%s: %s\n", in.fname, strerror(errno));
+    if (argc == 5) {
+        out.fname = argv[4];
+        out.f = fopen(out.fname, "w");
+        if (out.f == NULL)
+            quit("%s: %s\n", out.fname, strerror(errno));
+    }
+
+    V = (double**)(alloc2d(n, n, sizeof(double)));
+    w = (double*)(malloc(n * sizeof(double)));
+    W = (double**)(alloc2d(n, n, sizeof(double)));
+
+    printf("performing SVD:");
+
+    m = svd_stream(n, 0, text_read, &in, w, V, (argc == 5) ? text_write : NULL, &out);
+
+    printf(" done\n");
+    printf("m = %d\n", m);
+
+    for (i = 0; i < n; ++i)
+        W[i][i] = w[i];
+
+    printf("W = \n");
+    matrix_print(n, n, W, "  ");
+    printf("V =\n");
+    matrix_print(n, n, V, "  ");
+
+    fclose(in.f);
+    if (argc == 5 && fclose(out.f) != 0)
+        quit("%s: %s\n", out.fname, strerror(errno));
+    free(w);
+    free2d(V);
+    free2d(W);
+
+    return 0;
+}
+
+static int cmp_decreasing(const void* p1, const void* p2)
+{
+    double v1 = *(const double*) p1;
+    double v2 = *(const double*) p2;
+
+    return (v1 < v2) - (v1 > v2);
+}
+
+/* svd -f <file> [-U <file>] [-W <file>] [-V <file>] */
+static int main_file(int argc, char* argv[])
+{
+    struct matfile mf, mu, mv;
+    const char* ufile = NULL;
+    const char* wfile = NULL;
+    const char* vfile = NULL;
+    double** A;
+    double** V = NULL;
+    double* w = NULL;
+    int m, n, mnmin, i;
+
+    if (argc < 3)
+        usage();
+    for (i = 3; i < argc; ++i) {
+        if (i + 1 < argc && strcmp(argv[i], "-U") == 0)
+            ufile = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "-W") == 0)
+            wfile = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "-V") == 0)
+            vfile = argv[++i];
+        else
+            usage();
+    }
+
+    matfile_open(argv[2], &mf);
+    m = mf.m;
+    n = mf.n;
+    printf("A: %d x %d\n", m, n);
+
+    mnmin = (n < m) ? n : m;
+    w = (double*)(malloc(mnmin * sizeof(double)));
+
+    printf("performing SVD:");
+
+    if (ufile == NULL && vfile == NULL) {
+        svd_values(mf.A, n, m, w);
+        qsort(w, mnmin, sizeof(double), cmp_decreasing);
+        matfile_close(&mf);
+    } else {
+        /*
+         * U overwrites A, which is therefore copied into the mapped U file
+         * (tall case, U has the shape of A); V is decomposed into its
+         * mapped file
+         */
+        A = mf.A;
+        if (ufile != NULL && m >= n) {
+            matfile_create(ufile, n, m, &mu);
+            for (i = 0; i < m; ++i)
+                memcpy(mu.A[i], mf.A[i], n * sizeof(double));
+            matfile_close(&mf);
+            A = mu.A;
+        }
+        if (vfile != NULL) {
+            matfile_create(vfile, mnmin, n, &mv);
+            V = mv.A;
+        } else
+            V = (double**)(alloc2d(mnmin, n, sizeof(double)));
+
+        svd(A, n, m, w, V);
+        svd_sort(A, n, m, w, V);
+
+        if (ufile != NULL && m >= n)
+            matfile_close(&mu);
+        else {
+            if (ufile != NULL)
+                matfile_write(ufile, mnmin, m, 0, A);
+            matfile_close(&mf);
+        }
+        if (vfile != NULL)
+            matfile_close(&mv);
+        else
+            free2d(V);
+    }
+
+    printf(" done\n");
+
+    if (wfile != NULL)
+        matfile_write(wfile, mnmin, 1, 1, &w);
+    else {
+        printf("w =\n");
+        matrix_print(mnmin, 1, &w, "  ");
+    }
+
+    free(w);
+
+    return 0;
+}
+
+/* svd -g <ncolumns> <nrows> <mode> <cond> <file> [-r <rank>] [-G]
+ * [-S <seed>] */
+static int main_gen(int argc, char* argv[])
+{
+    double** A;
+    double* sigma;
+    int m, n, mode, rank = 0, graded = 0;
+    unsigned int seed = 0;
+    double cond;
+    int i;
+
+    if (argc < 7)
+        usage();
+    n = atoi(argv[2]);
+    m = atoi(argv[3]);
+    mode = atoi(argv[4]);
+    cond = atof(argv[5]);
+    for (i = 7; i < argc; ++i) {
+        if (i + 1 < argc && strcmp(argv[i], "-r") == 0)
+            rank = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-S") == 0)
+            seed = (unsigned int) strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-G") == 0)
+            graded = 1;
+        else
+            usage();
+    }
+    if (n <= 0)
+        quit("n = %d; expected n > 0\n", n);
+    if (m <= 0)
+        quit("m = %d; expected m > 0\n", m);
+
+    A = (double**)(alloc2d(n, m, sizeof(double)));
+    sigma = (double*)(malloc(((n < m) ? n : m) * sizeof(double)));
+    svd_spectrum((n < m) ? n : m, mode, cond, rank, seed, sigma);
+    svd_gen(A, n, m, sigma, graded, seed);
+    matfile_write(argv[6], n, m, 0, A);
+
+    free2d(A);
+    free(sigma);
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    int m, n, mnmin, i, j, k;
+    double** A = nullptr;
+    double** A_inv = nullptr;
+    double** V = NULL;
+    double* w = NULL;
+    double** W = NULL;
+
+    if (argc > 1 && strcmp(argv[1], "-f") == 0)
+        return main_file(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "-s") == 0)
+        return main_stream(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "-g") == 0)
+        return main_gen(argc, argv);
+    if (argc < 4)
+        usage();
+
+    n = atoi(argv[1]);
+    m = atoi(argv[2]);
+    mnmin = (n < m) ? n : m;
+
+    if (n <= 0)
+        quit("n = %d; expected n > 0\n", n);
+    if (m <= 0)
+        quit("m = %d; expected m > 0\n", m);
+
+    if (argc != m * n + 3)
+        usage();
+
+    A = (double**)(alloc2d(n, m, sizeof(double)));
+    A_inv = (double**)(alloc2d(m, n, sizeof(double)));
+
+    for (j = 0, k = 3; j < m; ++j)
+        for (i = 0; i < n; ++i, ++k)
+            A[j][i] = atof(argv[k]);
+
+    printf("A = \n");
+    matrix_print(n, m, A, "  ");
+
+    V = (double**)(alloc2d(mnmin, n, sizeof(double)));
+    w = (double*)(malloc(mnmin * sizeof(double)));
+    W = (double**)(alloc2d(mnmin, mnmin, sizeof(double)));
+
+    printf("performing SVD:");
+
+    svd(A, n, m, w, V);
+
+    printf(" done\n");
+
+    for (i = 0; i < mnmin; ++i)
+        W[i][i] = w[i];
+
+    printf("U =\n");
+    matrix_print(mnmin, m, A, "  ");
+    printf("W = \n");
+    matrix_print(mnmin, mnmin, W, "  ");
+    printf("V =\n");
+    matrix_print(mnmin, n, V, "  ");
+
+    printf("performing sorting:");
+
+    svd_sort(A, n, m, w, V);
+
+    printf(" done\n");
+
+    for (i = 0; i < mnmin; ++i)
+        W[i][i] = w[i];
+
+    printf("U =\n");
+    matrix_print(mnmin, m, A, "  ");
+    printf("W = \n");
+    matrix_print(mnmin, mnmin, W, "  ");
+    printf("V =\n");
+    matrix_print(mnmin, n, V, "  ");
+
+    printf("performing inverse:");
+
+    svd_invs(A, n, m, w, V, A_inv);
+
+    printf(" done\n");
+
+    printf("A.T =\n");
+    matrix_print(m, n, A_inv, "  ");
+
+    free2d(A);
+    free(w);
+    free2d(V);
+    free2d(W);
+    free2d(A_inv);
+
+    return 0;
+}
\ No newline at end of file
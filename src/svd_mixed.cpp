@@ -0,0 +1,321 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <float.h>
+
+#include "svd.hpp"
+#include "svd_internal.hpp"
+
+#define SVD_MPMAX 8             /* refinement steps of svd_mixed() */
+#define SVD_MPTOL 4.0           /* accepted error, in units of
+                                 * sqrt(max(m,n)).DBL_EPSILON (about 2 for
+                                 * the triplets of svd()) */
+
+/* Transposes A [0..m-1][0..n-1] into At [0..n-1][0..m-1]. */
+static void transpose(int n, int m, double** A, double** At)
+{
+    int i, j;
+
+    for (i = 0; i < m; i++)
+        for (j = 0; j < n; j++)
+            At[j][i] = A[i][j];
+}
+
+/* One refinement step for approximate singular triplets of a matrix with
+ * m >= n, after Ogita & Aishima (2020).
+ *
+ * The refined factors are sought as U + U.F + E and V + V.G, with E
+ * orthogonal to U. To first order, orthonormality gives F + F' = P = I - U'.U
+ * and G + G' = Q = I - V'.V, and A.V = U.W, A'.U = V.W give, for i != j,
+ *   F_ij.w_j - w_i.G_ij = T_ij + P_ij.w_j,
+ *   G_ij.w_j - w_i.F_ij = T_ji + Q_ij.w_j,
+ * where T = U'.A.V, and w_i = T_ii / (1 - (P_ii + Q_ii) / 2). The diagonals
+ * of F and G are P_ii / 2 and Q_ii / 2, and so are the entries of F and G
+ * within clusters of singular values, where the 2x2 systems above are
+ * singular. E is the part of A.V outside the span of U, scaled by 1 / w.
+ * Everything except the 2x2 systems is a matrix product.
+ *
+ * The step is skipped if the triplets are already accurate to tol, in
+ * terms of the largest entries of P, Q, the off-diagonal of T and A.V - U.T
+ * relative to the largest singular value.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param U Input-output matrix U [0..m-1][0..n-1]
+ * @param w Input-output vector [0..n-1] of singular values
+ * @param V Input-output matrix V [0..n-1][0..n-1]
+ * @param tol Tolerance
+ * @return Error of the input triplets
+ */
+static double refine(double** A, int n, int m, double** U, double* w, double** V, double tol)
+{
+    double** AV = (double**)(alloc2d(n, m, sizeof(double)));
+    double** R = (double**)(alloc2d(n, m, sizeof(double)));
+    double** Ut = (double**)(alloc2d(m, n, sizeof(double)));
+    double** Vt = (double**)(alloc2d(n, n, sizeof(double)));
+    double** T = (double**)(alloc2d(n, n, sizeof(double)));
+    double** P = (double**)(alloc2d(n, n, sizeof(double)));
+    double** Q = (double**)(alloc2d(n, n, sizeof(double)));
+    double** F = (double**)(alloc2d(n, n, sizeof(double)));
+    double** G = (double**)(alloc2d(n, n, sizeof(double)));
+    double wmax = 0.0;
+    double pqmax = 0.0;
+    double tmax = 0.0;
+    double rmax = 0.0;
+    double err, delta, ethr;
+    int i, j;
+
+    transpose(n, m, U, Ut);
+    transpose(n, n, V, Vt);
+    matmul(m, n, n, A, V, AV);
+    matmul(n, n, m, Ut, AV, T);
+    matmul(n, n, m, Ut, U, P);
+    matmul(n, n, n, Vt, V, Q);
+    for (i = 0; i < n; i++)
+        for (j = 0; j < n; j++) {
+            P[i][j] = ((i == j) ? 1.0 : 0.0) - P[i][j];
+            Q[i][j] = ((i == j) ? 1.0 : 0.0) - Q[i][j];
+            pqmax = fmax(pqmax, fmax(fabs(P[i][j]), fabs(Q[i][j])));
+            if (i != j)
+                tmax = fmax(tmax, fabs(T[i][j]));
+        }
+    for (i = 0; i < n; i++) {
+        w[i] = T[i][i] / (1.0 - 0.5 * (P[i][i] + Q[i][i]));
+        wmax = fmax(wmax, fabs(w[i]));
+    }
+
+    /*
+     * A.V - U.(I + P).T, the part of A.V outside the span of U (the
+     * projection allows for U not being orthonormal)
+     */
+    matmul(n, n, n, P, T, F);
+    for (i = 0; i < n; i++)
+        for (j = 0; j < n; j++)
+            F[i][j] += T[i][j];
+    matmul(m, n, n, U, F, R);
+    for (i = 0; i < m; i++)
+        for (j = 0; j < n; j++) {
+            AV[i][j] -= R[i][j];
+            rmax = fmax(rmax, fabs(AV[i][j]));
+        }
+
+    err = (wmax > 0.0) ? fmax(pqmax, fmax(tmax, rmax) / wmax) : pqmax;
+    if (err > tol) {
+        delta = 2.0 * pqmax * wmax;
+        ethr = 4.0 * pqmax * wmax;
+
+        for (i = 0; i < n; i++)
+            for (j = 0; j < n; j++) {
+                double x, y;
+                double d = (w[j] - w[i]) * (w[j] + w[i]);
+
+                if (i == j || fabs(w[i] - w[j]) <= delta || d == 0.0) {
+                    F[i][j] = 0.5 * P[i][j];
+                    G[i][j] = 0.5 * Q[i][j];
+                } else {
+                    x = T[i][j] + P[i][j] * w[j];
+                    y = T[j][i] + Q[i][j] * w[j];
+                    F[i][j] = (w[j] * x + w[i] * y) / d;
+                    G[i][j] = (w[i] * x + w[j] * y) / d;
+                }
+            }
+
+        /*
+         * E; columns for singular values at the level of the error are left
+         * to the orthogonalisation by F
+         */
+        for (i = 0; i < m; i++)
+            for (j = 0; j < n; j++)
+                AV[i][j] = (w[j] > ethr) ? AV[i][j] / w[j] : 0.0;
+
+        matmul(m, n, n, U, F, R);
+        for (i = 0; i < m; i++)
+            for (j = 0; j < n; j++)
+                U[i][j] += R[i][j] + AV[i][j];
+        matmul(n, n, n, V, G, R);
+        for (i = 0; i < n; i++)
+            for (j = 0; j < n; j++)
+                V[i][j] += R[i][j];
+    }
+
+    free2d(AV);
+    free2d(R);
+    free2d(Ut);
+    free2d(Vt);
+    free2d(T);
+    free2d(P);
+    free2d(Q);
+    free2d(F);
+    free2d(G);
+
+    return err;
+}
+
+/* Copies the l x k matrix X into Y. */
+static void copy(int k, int l, double** X, double** Y)
+{
+    int i;
+
+    for (i = 0; i < l; i++)
+        memcpy(Y[i], X[i], k * sizeof(double));
+}
+
+/** Performs singular value decomposition in single precision, refined to
+ * double accuracy.
+ *
+ * svd() is run on a float copy of A, scaled by a power of two to a largest
+ * entry of order 1 so that it neither overflows nor underflows; the
+ * triplets are then refined in double by the iteration of Ogita & Aishima
+ * (2020), which consists of matrix products and converges quadratically,
+ * until the error is at the level of that of svd() (see SVD_MPTOL). Two or
+ * three steps are needed from float accuracy. The iteration stops as soon
+ * as the error no longer decreases, and the best triplets are kept; if
+ * their error is above the tolerance (graded matrices, whose small singular
+ * values are lost in float), the decomposition is redone by svd() in
+ * double.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]; output matrix U [0..m-1][0..k-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param w Ouput vector [0..k-1] that presents diagonal matrix W
+ * @param V output matrix V [0..n-1][0..k-1] (not transposed)
+ * @return Number of refinement steps, or -1 if the refinement did not
+ *         reach the tolerance and svd() was used instead
+ */
+int svd_mixed(double** A, int n, int m, double* w, double** V)
+{
+    int k = (m < n) ? m : n;
+    int l = (m < n) ? n : m;
+    float** Af = (float**)(alloc2d(n, m, sizeof(float)));
+    float** Vf = (float**)(alloc2d(k, n, sizeof(float)));
+    float* wf = (float*)(malloc(k * sizeof(float)));
+    double** Uc = (double**)(alloc2d(k, l, sizeof(double)));
+    double** Vc = (double**)(alloc2d(k, k, sizeof(double)));
+    double** Us = (double**)(alloc2d(k, l, sizeof(double)));
+    double** Vs = (double**)(alloc2d(k, k, sizeof(double)));
+    double* ws = (double*)(malloc(k * sizeof(double)));
+    double** B;
+    double** Ub;
+    double** Vb;
+    double tol = SVD_MPTOL * sqrt((double) l) * DBL_EPSILON;
+    double amax = 0.0;
+    double best = HUGE_VAL;
+    int e = 0;
+    int i, j, step;
+
+    for (i = 0; i < m; i++)
+        for (j = 0; j < n; j++)
+            amax = fmax(amax, fabs(A[i][j]));
+    if (amax > 0.0 && amax <= DBL_MAX)
+        frexp(amax, &e);
+
+    /*
+     * the refinement works on B = A (m >= n) or B = A' (m < n), scaled like
+     * the float copy, with B = Ub.W.Vb'
+     */
+    B = (m >= n) ? (double**)(alloc2d(n, m, sizeof(double))) : (double**)(alloc2d(m, n, sizeof(double)));
+    for (i = 0; i < m; i++)
+        for (j = 0; j < n; j++) {
+            double a = ldexp(A[i][j], -e);
+
+            Af[i][j] = (fabs(a) >= FLT_MIN) ? (float) a : 0.0f;
+            if (m >= n)
+                B[i][j] = a;
+            else
+                B[j][i] = a;
+        }
+    svd(Af, n, m, wf, Vf);
+    for (i = 0; i < k; i++)
+        w[i] = wf[i];
+
+    if (m >= n) {
+        for (i = 0; i < m; i++)
+            for (j = 0; j < n; j++)
+                A[i][j] = Af[i][j];
+        for (i = 0; i < n; i++)
+            for (j = 0; j < n; j++)
+                V[i][j] = Vf[i][j];
+        Ub = A;
+        Vb = V;
+    } else {
+        Vb = (double**)(alloc2d(m, m, sizeof(double)));
+        for (i = 0; i < m; i++)
+            for (j = 0; j < m; j++)
+                Vb[i][j] = Af[i][j];
+        for (i = 0; i < n; i++)
+            for (j = 0; j < m; j++)
+                V[i][j] = Vf[i][j];
+        Ub = V;
+    }
+    free2d(Af);
+    free2d(Vf);
+    free(wf);
+
+    /*
+     * refine() returns the error of its input and w for it, so the input is
+     * kept in Uc, Vc and becomes the best iterate Us, ws, Vs if the error
+     * has decreased
+     */
+    for (step = 0; step <= SVD_MPMAX; step++) {
+        double t = (step < SVD_MPMAX) ? tol : HUGE_VAL;
+        double** X;
+        double err;
+
+        copy(k, l, Ub, Uc);
+        copy(k, k, Vb, Vc);
+        err = refine(B, k, l, Ub, w, Vb, t);
+        if (svd_verbose) {
+            fprintf(stderr, "  svd: refinement step %d: error %.3g\n", step, err);
+            fflush(stderr);
+        }
+        if (!(err < best))
+            break;
+        best = err;
+        X = Us, Us = Uc, Uc = X;
+        X = Vs, Vs = Vc, Vc = X;
+        memcpy(ws, w, k * sizeof(double));
+        if (err <= tol)
+            break;
+    }
+    copy(k, l, Us, Ub);
+    copy(k, k, Vs, Vb);
+    memcpy(w, ws, k * sizeof(double));
+
+    /*
+     * w_i = u_i'.A.v_i can come out negative for a null singular value
+     */
+    for (j = 0; j < k; j++) {
+        if (w[j] < 0.0) {
+            w[j] = -w[j];
+            for (i = 0; i < l; i++)
+                Ub[i][j] = -Ub[i][j];
+        }
+        w[j] = ldexp(w[j], e);
+    }
+
+    if (m < n) {
+        copy(m, m, Vb, A);
+        free2d(Vb);
+    }
+    if (best > tol) {
+        if (svd_verbose) {
+            fprintf(stderr, "  svd: refinement error %.3g above %.3g, using svd()\n", best, tol);
+            fflush(stderr);
+        }
+        for (i = 0; i < m; i++)
+            for (j = 0; j < n; j++)
+                A[i][j] = ldexp((m >= n) ? B[i][j] : B[j][i], e);
+        svd(A, n, m, w, V);
+        step = -1;
+    }
+    free2d(B);
+    free2d(Uc);
+    free2d(Vc);
+    free2d(Us);
+    free2d(Vs);
+    free(ws);
+
+    return step;
+}
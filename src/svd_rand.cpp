@@ -0,0 +1,183 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <float.h>
+
+#include "svd.hpp"
+#include "svd_internal.hpp"
+
+#define SVD_RNEST 10            /* probe vectors of the error estimate */
+
+/* Orthonormalises the rows X[0..l-1] in place. Rows that turn out to be
+ * linearly dependent are replaced by random orthonormal ones.
+ */
+static void orthonormalise(int n, int l, double** X, unsigned long long* state)
+{
+    int i, j;
+
+    for (j = 0; j < l; j++) {
+        double s = 0.0;
+        double nrm;
+
+        for (i = 0; i < n; i++)
+            s += X[j][i] * X[j][i];
+        nrm = reorth(n, X[j], X, j);
+        if (nrm <= sqrt(DBL_EPSILON) * sqrt(s) || nrm == 0.0)
+            randvec(n, X[j], X, j, state);
+        else
+            for (i = 0; i < n; i++)
+                X[j][i] /= nrm;
+    }
+}
+
+/* Transposes A [0..m-1][0..n-1] into At [0..n-1][0..m-1]. */
+static void transpose(int n, int m, double** A, double** At)
+{
+    int i, j;
+
+    for (i = 0; i < m; i++)
+        for (j = 0; j < n; j++)
+            At[j][i] = A[i][j];
+}
+
+/** Computes a rank-k approximation of a matrix by randomised SVD (Halko,
+ * Martinsson & Tropp).
+ *
+ * The range of A is sampled as Y = A.Omega for a Gaussian n x (k+p) matrix
+ * Omega and orthonormalised, Y = Q.R, after q power iterations
+ * Y = (A.A')^q.A.Omega (reorthonormalised at each half-step). The small
+ * matrix B = Q'.A is then decomposed by svd(), and U = Q.U_B. Only a few
+ * passes over A are made, each a matrix product.
+ *
+ * The error estimate is max |(A - U.W.V').x_i| over SVD_RNEST Gaussian
+ * vectors x_i, times 10.sqrt(2/pi), which bounds the spectral norm of
+ * A - U.W.V' with probability at least 1 - 10^-SVD_RNEST.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param k Rank, 0 < k <= min(m,n)
+ * @param p Oversampling (typically 5 to 10)
+ * @param q Number of power iterations (typically 0 to 2)
+ * @param seed Seed of the random number generator
+ * @param U Output matrix U [0..m-1][0..k-1]
+ * @param w Output vector [0..k-1] of singular values (decreasing)
+ * @param V Output matrix V [0..n-1][0..k-1] (not transposed)
+ * @param err Output estimate of the approximation error, or NULL
+ */
+void svd_rand(double** A, int n, int m, int k, int p, int q, unsigned int seed, double** U, double* w, double** V, double* err)
+{
+    int mnmin = (m < n) ? m : n;
+    int l = k + ((p > 0) ? p : 0);
+    unsigned long long state = 0x9E3779B97F4A7C15ULL * ((unsigned long long) seed + 1);
+    double** Om;
+    double** Y;
+    double** Qt;
+    double** Zt;
+    double** B;
+    double** Vb;
+    double* wb;
+    int i, j, t, it;
+
+    if (k <= 0 || k > mnmin)
+        quit("svd_rand(): invalid rank (k = %d)\n", k);
+    if (l > mnmin)
+        l = mnmin;
+    state ^= state >> 31;
+
+    Om = (double**)(alloc2d(l, n, sizeof(double)));
+    Y = (double**)(alloc2d(l, m, sizeof(double)));
+    Qt = (double**)(alloc2d(m, l, sizeof(double)));
+    Zt = (double**)(alloc2d(n, l, sizeof(double)));
+
+    if (svd_verbose) {
+        fprintf(stderr, "  svd: randomised range finder (%d samples, %d power iterations)\n", l, q);
+        fflush(stderr);
+    }
+
+    /*
+     * Q = orth(A.Omega)
+     */
+    for (i = 0; i < n; i++)
+        for (j = 0; j < l; j++)
+            Om[i][j] = randn(&state);
+    matmul(m, l, n, A, Om, Y);
+    transpose(l, m, Y, Qt);
+    orthonormalise(m, l, Qt, &state);
+
+    /*
+     * power iterations: Z = orth(A'.Q), Q = orth(A.Z)
+     */
+    for (it = 0; it < q; it++) {
+        matmul(l, n, m, Qt, A, Zt);
+        orthonormalise(n, l, Zt, &state);
+        transpose(n, l, Zt, Om);
+        matmul(m, l, n, A, Om, Y);
+        transpose(l, m, Y, Qt);
+        orthonormalise(m, l, Qt, &state);
+    }
+
+    /*
+     * B = Q'.A = U_B.W.V', U = Q.U_B
+     */
+    B = (double**)(alloc2d(n, l, sizeof(double)));
+    Vb = (double**)(alloc2d(l, n, sizeof(double)));
+    wb = (double*)(malloc(l * sizeof(double)));
+    matmul(l, n, m, Qt, A, B);
+    svd(B, n, l, wb, Vb);
+    svd_sort(B, n, l, wb, Vb);
+    for (i = 0; i < m; i++)
+        for (j = 0; j < k; j++) {
+            double s = 0.0;
+
+            for (t = 0; t < l; t++)
+                s += Qt[t][i] * B[t][j];
+            U[i][j] = s;
+        }
+    for (i = 0; i < n; i++)
+        memcpy(V[i], Vb[i], k * sizeof(double));
+    memcpy(w, wb, k * sizeof(double));
+
+    if (err != NULL) {
+        double** X = (double**)(alloc2d(SVD_RNEST, n, sizeof(double)));
+        double** AX = (double**)(alloc2d(SVD_RNEST, m, sizeof(double)));
+        double emax = 0.0;
+
+        for (i = 0; i < n; i++)
+            for (j = 0; j < SVD_RNEST; j++)
+                X[i][j] = randn(&state);
+        matmul(m, SVD_RNEST, n, A, X, AX);
+        for (j = 0; j < SVD_RNEST; j++) {
+            double e = 0.0;
+
+            for (t = 0; t < k; t++) {
+                double s = 0.0;
+
+                for (i = 0; i < n; i++)
+                    s += V[i][t] * X[i][j];
+                wb[t] = w[t] * s;
+            }
+            for (i = 0; i < m; i++) {
+                double y = AX[i][j];
+
+                for (t = 0; t < k; t++)
+                    y -= U[i][t] * wb[t];
+                e += y * y;
+            }
+            emax = (e > emax) ? e : emax;
+        }
+        *err = 10.0 * sqrt(2.0 / 3.14159265358979323846) * sqrt(emax);
+
+        free2d(X);
+        free2d(AX);
+    }
+
+    free2d(Om);
+    free2d(Y);
+    free2d(Qt);
+    free2d(Zt);
+    free2d(B);
+    free2d(Vb);
+    free(wb);
+}
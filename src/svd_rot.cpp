@@ -0,0 +1,105 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "svd.hpp"
+#include "svd_internal.hpp"
+
+/* Applies a sequence of rotations to one panel of rows of SVD_RCB
+ * elements.
+ */
+template <typename T>
+static inline void rot_panel(int nrot, const givens<T>* g, T* panel)
+{
+    int t, i;
+
+    for (t = 0; t < nrot; t++) {
+        T* x = &panel[(size_t) g[t].p * SVD_RCB];
+        T* y;
+        T c = g[t].c;
+        T s = g[t].s;
+
+        if (g[t].q < 0) {
+            SVD_SIMD
+            for (i = 0; i < SVD_RCB; i++)
+                x[i] = -x[i];
+            continue;
+        }
+        y = &panel[(size_t) g[t].q * SVD_RCB];
+        SVD_SIMD
+        for (i = 0; i < SVD_RCB; i++) {
+            T a = x[i];
+            T b = y[i];
+
+            x[i] = a * c + b * s;
+            y[i] = b * c - a * s;
+        }
+    }
+}
+
+/*
+ * the float and double kernels are compiled for AVX-512, AVX2 (both with
+ * FMA) and generic x86-64
+ */
+static SVD_CLONES void rot_panel_clones(int nrot, const givens<float>* g, float* panel)
+{
+    rot_panel(nrot, g, panel);
+}
+
+static SVD_CLONES void rot_panel_clones(int nrot, const givens<double>* g, double* panel)
+{
+    rot_panel(nrot, g, panel);
+}
+
+static void rot_panel_clones(int nrot, const givens<long double>* g, long double* panel)
+{
+    rot_panel(nrot, g, panel);
+}
+
+/** Applies a sequence of plane rotations to the rows of a matrix stored
+ * in panels, in the order given: x_p = c.x_p + s.x_q, x_q = c.x_q - s.x_p
+ * for each entry (p, q, c, s); an entry with q < 0 negates row p.
+ *
+ * This is the inner loop of the QR sweep (see bidiag_qr()).
+ *
+ * The matrix is n x nr, stored as ceil(nr/SVD_RCB) contiguous panels of n
+ * rows of SVD_RCB elements each: element (i, j) is at
+ * P[((j / SVD_RCB) * n + i) * SVD_RCB + j % SVD_RCB]. All the rotations are
+ * applied to one panel, which stays in cache, before moving on to the next,
+ * so a sequence spanning several QR steps costs a single pass over the
+ * matrix instead of one per step. The panels are independent: with OpenMP,
+ * they are shared between nthreads threads, each applying the whole
+ * sequence to its own block of columns of U or V.
+ *
+ * @param nrot Number of rotations
+ * @param g Rotations [0..nrot-1]
+ * @param n Number of rows
+ * @param nr Length of the rows
+ * @param P Input-output matrix in panels
+ * @param nthreads Number of threads; 0 for the OpenMP default
+ */
+template <typename T>
+void rot_seq(int nrot, const givens<T>* g, int n, int nr, T* P, int nthreads)
+{
+    int npanel = (nr + SVD_RCB - 1) / SVD_RCB;
+    int b;
+
+#if defined(_OPENMP)
+    if (nthreads <= 0)
+        nthreads = omp_get_max_threads();
+    if (nthreads > npanel)
+        nthreads = npanel;
+#pragma omp parallel for schedule(static) num_threads(nthreads) if (nthreads > 1)
+#else
+    (void) nthreads;
+#endif
+    for (b = 0; b < npanel; b++)
+        rot_panel_clones(nrot, g, &P[(size_t) b * n * SVD_RCB]);
+}
+
+template void rot_seq(int, const givens<float>*, int, int, float*, int);
+template void rot_seq(int, const givens<double>*, int, int, double*, int);
+template void rot_seq(int, const givens<long double>*, int, int, long double*, int);
@@ -0,0 +1,264 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <float.h>
+
+#include "svd.hpp"
+#include "svd_internal.hpp"
+
+#define SVD_SOASWEEP 30         /* sweeps of the lane-parallel Jacobi method */
+
+/* SoA element v of entry (i, j) of a c x l block stored as [i][j][lane]. */
+#define IDX(i, j, l, v) (((i) * (l) + (j)) * SVD_LANES + (v))
+
+/* Replaces the null column j of the l x c row-major matrix U by a unit
+ * vector orthogonal to the other columns: the unit vector e_r that keeps most
+ * of its norm after Gram-Schmidt (twice) against them, normalised. Null
+ * columns are zero and drop out of the projections.
+ */
+static void complete(double* U, int c, int l, int j)
+{
+    double y[SVD_SOAMAX];
+    double x[SVD_SOAMAX];
+    double best = -1.0;
+    int r, i, k, pass;
+
+    for (r = 0; r < l; r++) {
+        double s = 0.0;
+
+        for (i = 0; i < l; i++)
+            y[i] = (i == r) ? 1.0 : 0.0;
+        for (pass = 0; pass < 2; pass++)
+            for (k = 0; k < c; k++) {
+                double d = 0.0;
+
+                if (k == j)
+                    continue;
+                for (i = 0; i < l; i++)
+                    d += U[i * c + k] * y[i];
+                for (i = 0; i < l; i++)
+                    y[i] -= d * U[i * c + k];
+            }
+        for (i = 0; i < l; i++)
+            s += y[i] * y[i];
+        if (s > best) {
+            best = s;
+            memcpy(x, y, l * sizeof(double));
+        }
+    }
+    best = 1.0 / sqrt(best);
+    for (i = 0; i < l; i++)
+        U[i * c + j] = x[i] * best;
+}
+
+/** One-sided Jacobi SVD of SVD_LANES matrices of the same size at once.
+ *
+ * The matrices are held in structure-of-arrays form, element by element
+ * with the lanes innermost, so that every arithmetic operation is a vector
+ * operation across matrices and all lanes go through the same sequence of
+ * (pair) steps. A lane whose pair is already orthogonal takes the identity
+ * rotation; sweeps continue until all lanes have converged.
+ *
+ * A matrix whose largest entry is beyond the fourth root of the overflow or
+ * underflow threshold is scaled by a power of two to a largest entry of
+ * order 1, so that the sums of squares neither overflow nor underflow. A
+ * column whose sum of squares underflows all the same is null. As in svd(),
+ * the columns of U (or V for wide matrices) of null singular values are
+ * completed to an orthonormal set. Fails if a lane has not converged after
+ * SVD_SOASWEEP sweeps.
+ *
+ * The layout of each lane is that of svd_batched(). A lane may be repeated
+ * to pad the last group of a batch.
+ *
+ * @param n Number of columns, n <= SVD_SOAMAX
+ * @param m Number of rows, m <= SVD_SOAMAX
+ * @param A Input matrices A [lane][0..m*n-1]; output matrices U
+ * @param w Output singular values [lane][0..k-1]
+ * @param V Output matrices V [lane][0..n*k-1]
+ */
+SVD_CLONES void svd_soa(int n, int m, double** A, double** w, double** V)
+{
+    /*
+     * the columns (m >= n) or rows (m < n) of A are orthogonalised: c
+     * vectors of length l
+     */
+    int c = (m < n) ? m : n;
+    int l = (m < n) ? n : m;
+    double G[SVD_SOAMAX * SVD_SOAMAX * SVD_LANES];
+    double R[SVD_SOAMAX * SVD_SOAMAX * SVD_LANES];
+    double nrm[SVD_SOAMAX * SVD_LANES];
+    double tol = DBL_EPSILON * l;
+    double small = sqrt(DBL_MIN) / DBL_EPSILON;  /* tol^2 * small^2 >= DBL_MIN */
+    double null = DBL_MIN / DBL_EPSILON;          /* squared norm of a null column */
+    double lo = ldexp(1.0, DBL_MIN_EXP / 4 + 1);  /* unscaled range of the */
+    double hi = ldexp(1.0, DBL_MAX_EXP / 4 - 2);  /* largest entry */
+    int e[SVD_LANES];
+    int i, j, p, q, v, sweep;
+
+    if (c > SVD_SOAMAX || l > SVD_SOAMAX)
+        quit("svd_soa(): matrix too large (n = %d, m = %d)\n", n, m);
+
+    for (v = 0; v < SVD_LANES; v++) {
+        double amax = 0.0;
+
+        for (i = 0; i < m * n; i++)
+            amax = (fabs(A[v][i]) > amax) ? fabs(A[v][i]) : amax;
+        e[v] = 0;
+        if ((amax > 0.0 && amax < lo) || (amax >= hi && amax <= DBL_MAX))
+            frexp(amax, &e[v]);
+    }
+    for (j = 0; j < c; j++)
+        for (i = 0; i < l; i++)
+            for (v = 0; v < SVD_LANES; v++) {
+                double a = (m >= n) ? A[v][i * n + j] : A[v][j * n + i];
+
+                G[IDX(j, i, l, v)] = (e[v] != 0) ? ldexp(a, -e[v]) : a;
+            }
+    for (j = 0; j < c; j++)
+        for (i = 0; i < c; i++)
+            for (v = 0; v < SVD_LANES; v++)
+                R[IDX(j, i, c, v)] = (i == j) ? 1.0 : 0.0;
+
+    for (sweep = 0; sweep < SVD_SOASWEEP; sweep++) {
+        int rotated = 0;
+
+        for (p = 0; p < c - 1; p++)
+            for (q = p + 1; q < c; q++) {
+                double alpha[SVD_LANES], beta[SVD_LANES], gamma[SVD_LANES];
+                double cs[SVD_LANES], sn[SVD_LANES], t[SVD_LANES];
+                int skip[SVD_LANES];
+                int any = 0, tiny = 0;
+
+                SVD_SIMD
+                for (v = 0; v < SVD_LANES; v++)
+                    alpha[v] = beta[v] = gamma[v] = 0.0;
+                for (i = 0; i < l; i++) {
+                    double* gp = &G[IDX(p, i, l, 0)];
+                    double* gq = &G[IDX(q, i, l, 0)];
+
+                    SVD_SIMD
+                    for (v = 0; v < SVD_LANES; v++) {
+                        double x = gp[v];
+                        double y = gq[v];
+
+                        alpha[v] += x * x;
+                        beta[v] += y * y;
+                        gamma[v] += x * y;
+                    }
+                }
+
+                SVD_SIMD
+                for (v = 0; v < SVD_LANES; v++) {
+                    double d = beta[v] - alpha[v];
+                    double g2 = 2.0 * gamma[v];
+
+                    skip[v] = gamma[v] * gamma[v] <= tol * tol * alpha[v] * beta[v];
+                    t[v] = ((d >= 0.0) ? g2 : -g2) / (fabs(d) + sqrt(d * d + g2 * g2));
+                }
+                /* The squares above cannot underflow unless a column is tiny.
+                 * Tiny columns take the unsquared test and the ratio form of
+                 * the angle; a column whose sum of squares underflows is null
+                 * and left alone. */
+                for (v = 0; v < SVD_LANES; v++)
+                    tiny |= (alpha[v] < small) | (beta[v] < small);
+                if (tiny)
+                    for (v = 0; v < SVD_LANES; v++) {
+                        double zeta = (beta[v] - alpha[v]) / (2.0 * gamma[v]);
+
+                        skip[v] = (alpha[v] < null) | (beta[v] < null) |
+                                  (fabs(gamma[v]) <= tol * sqrt(alpha[v]) * sqrt(beta[v]));
+                        t[v] = copysign(1.0, zeta) / (fabs(zeta) + sqrt(1.0 + zeta * zeta));
+                    }
+
+                SVD_SIMD
+                for (v = 0; v < SVD_LANES; v++) {
+                    double tv = skip[v] ? 0.0 : t[v];
+
+                    cs[v] = 1.0 / sqrt(1.0 + tv * tv);
+                    sn[v] = cs[v] * tv;
+                }
+                for (v = 0; v < SVD_LANES; v++)
+                    any |= (sn[v] != 0.0);
+                if (!any)
+                    continue;
+                rotated = 1;
+
+                for (i = 0; i < l; i++) {
+                    double* gp = &G[IDX(p, i, l, 0)];
+                    double* gq = &G[IDX(q, i, l, 0)];
+
+                    SVD_SIMD
+                    for (v = 0; v < SVD_LANES; v++) {
+                        double x = gp[v];
+                        double y = gq[v];
+
+                        gp[v] = cs[v] * x - sn[v] * y;
+                        gq[v] = sn[v] * x + cs[v] * y;
+                    }
+                }
+                for (i = 0; i < c; i++) {
+                    double* rp = &R[IDX(p, i, c, 0)];
+                    double* rq = &R[IDX(q, i, c, 0)];
+
+                    SVD_SIMD
+                    for (v = 0; v < SVD_LANES; v++) {
+                        double x = rp[v];
+                        double y = rq[v];
+
+                        rp[v] = cs[v] * x - sn[v] * y;
+                        rq[v] = sn[v] * x + cs[v] * y;
+                    }
+                }
+            }
+        if (!rotated)
+            break;
+    }
+    if (sweep == SVD_SOASWEEP)
+        quit("svd_soa(): no convergence in %d sweeps\n", SVD_SOASWEEP);
+
+    for (j = 0; j < c; j++) {
+        SVD_SIMD
+        for (v = 0; v < SVD_LANES; v++)
+            nrm[j * SVD_LANES + v] = 0.0;
+        for (i = 0; i < l; i++) {
+            double* g = &G[IDX(j, i, l, 0)];
+
+            SVD_SIMD
+            for (v = 0; v < SVD_LANES; v++)
+                nrm[j * SVD_LANES + v] += g[v] * g[v];
+        }
+        SVD_SIMD
+        for (v = 0; v < SVD_LANES; v++)
+            nrm[j * SVD_LANES + v] = sqrt(nrm[j * SVD_LANES + v]);
+    }
+
+    for (v = 0; v < SVD_LANES; v++) {
+        double* a = A[v];
+        double* vv = V[v];
+        int nnull = 0;
+
+        for (j = 0; j < c; j++) {
+            double s = nrm[j * SVD_LANES + v];
+            double f = (s * s >= null) ? 1.0 / s : 0.0;
+
+            nnull += (f == 0.0);
+            w[v][j] = (e[v] != 0) ? ldexp(s, e[v]) : s;
+            for (i = 0; i < l; i++) {
+                if (m >= n)
+                    a[i * n + j] = G[IDX(j, i, l, v)] * f;
+                else
+                    vv[i * c + j] = G[IDX(j, i, l, v)] * f;
+            }
+            for (i = 0; i < c; i++) {
+                if (m >= n)
+                    vv[i * c + j] = R[IDX(j, i, c, v)];
+                else
+                    a[i * n + j] = R[IDX(j, i, c, v)];
+            }
+        }
+        for (j = 0; nnull > 0 && j < c; j++)
+            if (!(nrm[j * SVD_LANES + v] * nrm[j * SVD_LANES + v] >= null))
+                complete((m >= n) ? a : vv, c, l, j);
+    }
+}
@@ -0,0 +1,367 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <limits.h>
+
+#include "svd.hpp"
+#include "svd_internal.hpp"
+
+#define SVD_SB 1048576          /* elements in a row block of svd_stream() */
+
+/* Node of the reduction tree of svd_stream(): a leaf (a row block of A) or
+ * the QR factorisation of the stacked R factors of two subtrees. */
+struct tsqr_node {
+    int left, right;            /* children, or -1 for a leaf */
+    int nr;                     /* leaf: number of rows; otherwise record
+                                 * in the temporary file */
+};
+
+/* R factor of a subtree, on the stack of the reduction. */
+struct tsqr_entry {
+    double** R;
+    int node;
+    int level;
+};
+
+struct tsqr {
+    int n;
+    struct tsqr_node* node;
+    int nnodes;
+    int nalloc;
+    int nrec;
+    FILE* tmp;                  /* reflectors of the internal nodes */
+    svd_rowsource src;
+    void* psrc;
+    svd_rowsink sink;
+    void* psink;
+    double** Y;
+    double** Z;
+    double* tau;
+    double* x;
+    double* s;
+};
+
+static int tsqr_newnode(struct tsqr* t, int left, int right, int nr)
+{
+    if (t->nnodes == t->nalloc) {
+        t->nalloc = (t->nalloc > 0) ? 2 * t->nalloc : 64;
+        t->node = (struct tsqr_node*)(realloc(t->node, t->nalloc * sizeof(struct tsqr_node)));
+        if (t->node == NULL)
+            quit("svd_stream(): out of memory\n");
+    }
+    t->node[t->nnodes].left = left;
+    t->node[t->nnodes].right = right;
+    t->node[t->nnodes].nr = nr;
+
+    return t->nnodes++;
+}
+
+/* Householder QR of a leaf block Y [0..nr-1][0..n-1]: the reflectors are
+ * left below the diagonal of Y, their factors in tau [0..min(nr,n)-1]. The
+ * R factor (rows nr..n-1 zero if nr < n) is copied to R if not NULL.
+ */
+static void leaf_qr(int n, int nr, double** Y, double* tau, double* x, double* s, double** R)
+{
+    int p = (nr < n) ? nr : n;
+    int i, j, r;
+
+    for (i = 0; i < p; i++) {
+        double beta, t, u0;
+
+        for (r = i; r < nr; r++)
+            x[r - i] = Y[r][i];
+        beta = householder(nr - i, x, &tau[i], &u0);
+        Y[i][i] = beta;
+        for (r = i + 1; r < nr; r++)
+            Y[r][i] = x[r - i];
+        if ((t = tau[i]) == 0.0)
+            continue;
+        for (j = i + 1; j < n; j++)
+            s[j] = Y[i][j];
+        for (r = i + 1; r < nr; r++) {
+            double v = Y[r][i];
+
+            for (j = i + 1; j < n; j++)
+                s[j] += v * Y[r][j];
+        }
+        for (j = i + 1; j < n; j++)
+            Y[i][j] -= t * s[j];
+        for (r = i + 1; r < nr; r++) {
+            double v = t * Y[r][i];
+
+            for (j = i + 1; j < n; j++)
+                Y[r][j] -= v * s[j];
+        }
+    }
+    if (R != NULL) {
+        memset(&R[0][0], 0, n * n * sizeof(double));
+        for (i = 0; i < p; i++)
+            for (j = i; j < n; j++)
+                R[i][j] = Y[i][j];
+    }
+}
+
+/* Forms Z = Q.[X; 0] [0..nr-1][0..n-1] from the reflectors of leaf_qr(). */
+static void leaf_apply(int n, int nr, double** Y, double* tau, double** X, double** Z, double* s)
+{
+    int p = (nr < n) ? nr : n;
+    int i, j, r;
+
+    memset(&Z[0][0], 0, nr * n * sizeof(double));
+    for (i = 0; i < p; i++)
+        memcpy(Z[i], X[i], n * sizeof(double));
+    for (i = p - 1; i >= 0; i--) {
+        double t = tau[i];
+
+        if (t == 0.0)
+            continue;
+        for (j = 0; j < n; j++)
+            s[j] = Z[i][j];
+        for (r = i + 1; r < nr; r++) {
+            double v = Y[r][i];
+
+            for (j = 0; j < n; j++)
+                s[j] += v * Z[r][j];
+        }
+        for (j = 0; j < n; j++)
+            Z[i][j] -= t * s[j];
+        for (r = i + 1; r < nr; r++) {
+            double v = t * Y[r][i];
+
+            for (j = 0; j < n; j++)
+                Z[r][j] -= v * s[j];
+        }
+    }
+}
+
+/* QR factorisation of [Ra; Rb], both upper triangular [0..n-1][0..n-1].
+ * Reflector i combines row i of Ra with rows 0..i of Rb. On exit Ra holds
+ * the new R, the upper triangle of Rb the reflectors and tau [0..n-1] their
+ * factors.
+ */
+static void node_qr(int n, double** Ra, double** Rb, double* tau, double* x, double* s)
+{
+    int i, j, r;
+
+    for (i = 0; i < n; i++) {
+        double t, u0;
+
+        x[0] = Ra[i][i];
+        for (r = 0; r <= i; r++)
+            x[r + 1] = Rb[r][i];
+        Ra[i][i] = householder(i + 2, x, &tau[i], &u0);
+        for (r = 0; r <= i; r++)
+            Rb[r][i] = x[r + 1];
+        if ((t = tau[i]) == 0.0)
+            continue;
+        for (j = i + 1; j < n; j++)
+            s[j] = Ra[i][j];
+        for (r = 0; r <= i; r++) {
+            double v = Rb[r][i];
+
+            for (j = i + 1; j < n; j++)
+                s[j] += v * Rb[r][j];
+        }
+        for (j = i + 1; j < n; j++)
+            Ra[i][j] -= t * s[j];
+        for (r = 0; r <= i; r++) {
+            double v = t * Rb[r][i];
+
+            for (j = i + 1; j < n; j++)
+                Rb[r][j] -= v * s[j];
+        }
+    }
+}
+
+/* Forms [Xa; Xb] = Q.[X; 0] from the reflectors of node_qr(); Xa may be X. */
+static void node_apply(int n, double** Rb, double* tau, double** X, double** Xa, double** Xb, double* s)
+{
+    int i, j, r;
+
+    if (Xa != X)
+        memcpy(&Xa[0][0], &X[0][0], n * n * sizeof(double));
+    memset(&Xb[0][0], 0, n * n * sizeof(double));
+    for (i = n - 1; i >= 0; i--) {
+        double t = tau[i];
+
+        if (t == 0.0)
+            continue;
+        for (j = 0; j < n; j++)
+            s[j] = Xa[i][j];
+        for (r = 0; r <= i; r++) {
+            double v = Rb[r][i];
+
+            for (j = 0; j < n; j++)
+                s[j] += v * Xb[r][j];
+        }
+        for (j = 0; j < n; j++)
+            Xa[i][j] -= t * s[j];
+        for (r = 0; r <= i; r++) {
+            double v = t * Rb[r][i];
+
+            for (j = 0; j < n; j++)
+                Xb[r][j] -= v * s[j];
+        }
+    }
+}
+
+/* Merges the R factors of the entries a (rows above) and b of the stack
+ * into a; the reflectors are appended to the temporary file.
+ */
+static void tsqr_merge(struct tsqr* t, struct tsqr_entry* a, struct tsqr_entry* b)
+{
+    int n = t->n;
+    long off = (long) t->nrec * (n + 1) * n * (long) sizeof(double);
+
+    node_qr(n, a->R, b->R, t->tau, t->x, t->s);
+    if (fseek(t->tmp, off, SEEK_SET) != 0 || fwrite(&b->R[0][0], sizeof(double), n * n, t->tmp) != (size_t) (n * n) || fwrite(t->tau, sizeof(double), n, t->tmp) != (size_t) n)
+        quit("svd_stream(): could not write the temporary file\n");
+    free2d(b->R);
+    a->node = tsqr_newnode(t, a->node, b->node, t->nrec++);
+    a->level++;
+}
+
+/* Second pass: writes the rows of U = Q.X for the subtree of node id. */
+static void tsqr_expand(struct tsqr* t, int id, double** X)
+{
+    struct tsqr_node* node = &t->node[id];
+    int n = t->n;
+
+    if (node->left < 0) {
+        if (t->src(t->psrc, node->nr, n, t->Y) != node->nr)
+            quit("svd_stream(): the rows changed between the passes\n");
+        leaf_qr(n, node->nr, t->Y, t->tau, t->x, t->s, NULL);
+        leaf_apply(n, node->nr, t->Y, t->tau, X, t->Z, t->s);
+        t->sink(t->psink, node->nr, n, t->Z);
+    } else {
+        double** Rb = (double**)(alloc2d(n, n, sizeof(double)));
+        double** Xb = (double**)(alloc2d(n, n, sizeof(double)));
+        double* tau = (double*)(malloc(n * sizeof(double)));
+        long off = (long) node->nr * (n + 1) * n * (long) sizeof(double);
+
+        if (fseek(t->tmp, off, SEEK_SET) != 0 || fread(&Rb[0][0], sizeof(double), n * n, t->tmp) != (size_t) (n * n) || fread(tau, sizeof(double), n, t->tmp) != (size_t) n)
+            quit("svd_stream(): could not read the temporary file\n");
+        node_apply(n, Rb, tau, X, X, Xb, t->s);
+        free2d(Rb);
+        free(tau);
+        tsqr_expand(t, node->left, X);
+        tsqr_expand(t, node->right, Xb);
+        free2d(Xb);
+    }
+}
+
+/** Performs singular value decomposition of a tall matrix that is read by
+ * row blocks and need not fit in memory.
+ *
+ * The row blocks are factorised by Householder QR and their R factors are
+ * merged pairwise in a binary reduction tree (TSQR), of which at most one R
+ * per level is kept; svd() is then run on the final R = U_R.W.V'. If a sink
+ * is given, the source is restarted and read a second time: the QR of each
+ * block is recomputed and U = Q.U_R is formed down the tree, whose node
+ * reflectors are kept in a temporary file (n + 1 rows of n per node). Memory
+ * is O(b.n + n^2.log(m/b)); the rows of U are written in order.
+ *
+ * @param n Number of columns
+ * @param b Number of rows in a block, or 0 for the default (SVD_SB / n, at
+ *          least n)
+ * @param src Row source
+ * @param psrc Data of the row source
+ * @param w Output vector [0..n-1] of singular values (decreasing)
+ * @param V Output matrix V [0..n-1][0..n-1] (not transposed)
+ * @param sink Row sink for U [0..m-1][0..n-1], or NULL
+ * @param psink Data of the row sink
+ * @return Number of rows m
+ */
+int svd_stream(int n, int b, svd_rowsource src, void* psrc, double* w, double** V, svd_rowsink sink, void* psink)
+{
+    struct tsqr t;
+    struct tsqr_entry* stack;
+    double** R;
+    int nstack = 0;
+    int m = 0;
+    int nr, i;
+
+    if (n <= 0)
+        quit("svd_stream(): n = %d; expected n > 0\n", n);
+    if (b <= 0)
+        b = SVD_SB / n;
+    if (b < n)
+        b = n;
+
+    memset(&t, 0, sizeof(t));
+    t.n = n;
+    t.src = src;
+    t.psrc = psrc;
+    t.sink = sink;
+    t.psink = psink;
+    t.Y = (double**)(alloc2d(n, b, sizeof(double)));
+    t.tau = (double*)(malloc(n * sizeof(double)));
+    t.x = (double*)(malloc((b + 1) * sizeof(double)));
+    t.s = (double*)(malloc(n * sizeof(double)));
+    t.tmp = tmpfile();
+    if (t.tmp == NULL)
+        quit("svd_stream(): could not create a temporary file\n");
+    stack = (struct tsqr_entry*)(malloc(64 * sizeof(struct tsqr_entry)));
+
+    /*
+     * first pass: a binary counter of R factors
+     */
+    while ((nr = src(psrc, b, n, t.Y)) > 0) {
+        struct tsqr_entry* e = &stack[nstack++];
+
+        if (m > INT_MAX - nr)
+            quit("svd_stream(): too many rows\n");
+        m += nr;
+        e->R = (double**)(alloc2d(n, n, sizeof(double)));
+        e->node = tsqr_newnode(&t, -1, -1, nr);
+        e->level = 0;
+        leaf_qr(n, nr, t.Y, t.tau, t.x, t.s, e->R);
+        while (nstack >= 2 && stack[nstack - 2].level == stack[nstack - 1].level) {
+            tsqr_merge(&t, &stack[nstack - 2], &stack[nstack - 1]);
+            nstack--;
+        }
+    }
+    if (m < n)
+        quit("svd_stream(): m = %d, n = %d; expected m >= n\n", m, n);
+    while (nstack >= 2) {
+        tsqr_merge(&t, &stack[nstack - 2], &stack[nstack - 1]);
+        nstack--;
+    }
+
+    if (svd_verbose) {
+        fprintf(stderr, "  svd: streaming QR reduction: %d x %d in blocks of %d rows\n", m, n, b);
+        fflush(stderr);
+    }
+
+    R = stack[0].R;
+    svd(R, n, n, w, V);
+    svd_sort(R, n, n, w, V);
+
+    /*
+     * second pass
+     */
+    if (sink != NULL) {
+        if (svd_verbose) {
+            fprintf(stderr, "  svd: forming U\n");
+            fflush(stderr);
+        }
+        t.Z = (double**)(alloc2d(n, b, sizeof(double)));
+        if (src(psrc, 0, n, NULL) != 0)
+            quit("svd_stream(): could not restart the row source\n");
+        tsqr_expand(&t, stack[0].node, R);
+        free2d(t.Z);
+    }
+
+    for (i = 0; i < nstack; i++)
+        free2d(stack[i].R);
+    free(stack);
+    free(t.node);
+    fclose(t.tmp);
+    free2d(t.Y);
+    free(t.tau);
+    free(t.x);
+    free(t.s);
+
+    return m;
+}
@@ -0,0 +1,237 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <float.h>
+
+#include "svd.hpp"
+#include "svd_internal.hpp"
+
+#define SVD_TKEXTRA 16          /* minimal number of Lanczos vectors in
+                                 * excess of k */
+#define SVD_TKMAXIT 300         /* restarts of the Lanczos process */
+#define SVD_TKTOL 1.0e-10       /* residual tolerance relative to the largest
+                                 * singular value */
+
+static double dot(int n, const double* x, const double* y)
+{
+    double s = 0.0;
+    int i;
+
+    for (i = 0; i < n; i++)
+        s += x[i] * y[i];
+    return s;
+}
+
+/* Golub-Kahan-Lanczos bidiagonalisation, steps l..p-1, with full
+ * reorthogonalisation. On exit A.Q' = P'.B and A'.P' = Q'.B' + f.e_p', where
+ * Q, P hold the Lanczos vectors as rows and B is upper triangular (upper
+ * bidiagonal apart from column l after a restart).
+ * @param A Input matrix [0..m-1][0..n-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param l Number of vectors kept from the previous cycle; Q[l] is set
+ * @param p Number of Lanczos vectors
+ * @param P Left vectors [0..p-1][0..m-1]; rows 0..l-1 set on input
+ * @param Q Right vectors [0..p-1][0..n-1]; rows 0..l set on input
+ * @param B Projected matrix [0..p-1][0..p-1]; rows 0..l-1 set on input
+ * @param f Output residual vector [0..n-1]
+ * @param anrm Input-output estimate of the norm of A
+ * @param state Random number generator state
+ * @return Norm of f
+ */
+static double gkl(double** A, int n, int m, int l, int p, double** P, double** Q, double** B, double* f, double* anrm, unsigned long long* state)
+{
+    double beta = 0.0;
+    int i, j;
+
+    for (j = l; j < p; j++) {
+        double* x = P[j];
+        double alpha;
+
+        /*
+         * p_j = A.q_j, orthogonalised
+         */
+#pragma omp parallel for
+        for (i = 0; i < m; i++)
+            x[i] = dot(n, A[i], Q[j]);
+        alpha = reorth(m, x, P, j);
+        *anrm = fmax(*anrm, alpha);
+        if (alpha <= DBL_EPSILON * *anrm) {
+            randvec(m, x, P, j, state);
+            alpha = 0.0;
+        } else
+            for (i = 0; i < m; i++)
+                x[i] /= alpha;
+        B[j][j] = alpha;
+
+        /*
+         * f = A'.p_j - alpha.q_j, orthogonalised
+         */
+        memset(f, 0, n * sizeof(double));
+        for (i = 0; i < m; i++) {
+            double c = x[i];
+            double* a = A[i];
+            int t;
+
+            if (c == 0.0)
+                continue;
+            for (t = 0; t < n; t++)
+                f[t] += c * a[t];
+        }
+        beta = reorth(n, f, Q, j + 1);
+        *anrm = fmax(*anrm, beta);
+        if (j == p - 1)
+            break;
+        if (beta <= DBL_EPSILON * *anrm) {
+            randvec(n, Q[j + 1], Q, j + 1, state);
+            beta = 0.0;
+        } else
+            for (i = 0; i < n; i++)
+                Q[j + 1][i] = f[i] / beta;
+        B[j][j + 1] = beta;
+    }
+    if (beta <= DBL_EPSILON * *anrm) {
+        memset(f, 0, n * sizeof(double));
+        beta = 0.0;
+    }
+
+    return beta;
+}
+
+/* Forms the rows Y[0..l-1] = X'.C[0..p-1][0..l-1] for Lanczos vectors X
+ * stored as rows, using T as workspace.
+ */
+static void ritzvec(int n, int p, int l, double** X, double** C, double** T)
+{
+    int i, j, t;
+
+    for (i = 0; i < l; i++) {
+        memset(T[i], 0, n * sizeof(double));
+        for (j = 0; j < p; j++) {
+            double c = C[j][i];
+
+            for (t = 0; t < n; t++)
+                T[i][t] += c * X[j][t];
+        }
+    }
+}
+
+/** Computes the k largest singular triplets of a matrix by thick-restart
+ * Golub-Kahan-Lanczos bidiagonalisation (Baglama & Reichel).
+ *
+ * A is only accessed through products with vectors and is not modified.
+ * Besides A, the storage needed is O((m+n).k). The triplets are sorted in
+ * order of decreasing singular values. Iterates until the residuals
+ * |A'.u_i - w_i.v_i| fall below 1e-10.w_0 (A.v_i = w_i.u_i holds exactly),
+ * or the restarts are exhausted.
+ *
+ * @param A Input matrix A [0..m-1][0..n-1]
+ * @param n Number of columns
+ * @param m Number of rows
+ * @param k Number of triplets, 0 < k <= min(m,n)
+ * @param U Output matrix U [0..m-1][0..k-1]
+ * @param w Output vector [0..k-1] of singular values
+ * @param V Output matrix V [0..n-1][0..k-1] (not transposed)
+ * @param res Output vector [0..k-1] of residual norms
+ */
+void svd_topk(double** A, int n, int m, int k, double** U, double* w, double** V, double* res)
+{
+    int mnmin = (m < n) ? m : n;
+    int p = (2 * k > k + SVD_TKEXTRA) ? 2 * k : k + SVD_TKEXTRA;
+    unsigned long long state = 88172645463325252ULL;
+    double** P;
+    double** Q;
+    double** T;
+    double** B;
+    double** X;
+    double** Y;
+    double* s;
+    double* f;
+    double fnrm, anrm = 0.0;
+    int i, j, it, l = 0;
+
+    if (k <= 0 || k > mnmin)
+        quit("svd_topk(): invalid number of triplets (k = %d)\n", k);
+    if (p > mnmin)
+        p = mnmin;
+
+    P = (double**)(alloc2d(m, p, sizeof(double)));
+    Q = (double**)(alloc2d(n, p, sizeof(double)));
+    T = (double**)(alloc2d((m > n) ? m : n, p, sizeof(double)));
+    B = (double**)(alloc2d(p, p, sizeof(double)));
+    X = (double**)(alloc2d(p, p, sizeof(double)));
+    Y = (double**)(alloc2d(p, p, sizeof(double)));
+    s = (double*)(malloc(p * sizeof(double)));
+    f = (double*)(malloc(n * sizeof(double)));
+
+    randvec(n, Q[0], Q, 0, &state);
+
+    for (it = 0; it < SVD_TKMAXIT; it++) {
+        int done = 1;
+
+        fnrm = gkl(A, n, m, l, p, P, Q, B, f, &anrm, &state);
+
+        /*
+         * B = X.diag(s).Y'; the Ritz triplets are (P'.X, s, Q'.Y)
+         */
+        for (i = 0; i < p; i++)
+            memcpy(X[i], B[i], p * sizeof(double));
+        svd_jacobi(X, p, p, s, Y);
+        svd_sort(X, p, p, s, Y);
+        for (i = 0; i < k; i++) {
+            res[i] = fnrm * fabs(X[p - 1][i]);
+            if (res[i] > SVD_TKTOL * s[0])
+                done = 0;
+        }
+        if (done || it == SVD_TKMAXIT - 1 || p == mnmin)
+            break;
+
+        /*
+         * thick restart with the l leading Ritz vectors and q_l = f/|f|:
+         * B = [diag(s) rho; 0 alpha_l], rho_i = |f|.X[p-1][i]
+         */
+        l = k + (p - k) / 2;
+        ritzvec(n, p, l, Q, Y, T);
+        for (i = 0; i < l; i++)
+            memcpy(Q[i], T[i], n * sizeof(double));
+        if (fnrm > 0.0)
+            for (i = 0; i < n; i++)
+                Q[l][i] = f[i] / fnrm;
+        else
+            randvec(n, Q[l], Q, l, &state);
+        ritzvec(m, p, l, P, X, T);
+        for (i = 0; i < l; i++)
+            memcpy(P[i], T[i], m * sizeof(double));
+        for (i = 0; i < p; i++)
+            memset(B[i], 0, p * sizeof(double));
+        for (i = 0; i < l; i++) {
+            B[i][i] = s[i];
+            B[i][l] = fnrm * X[p - 1][i];
+        }
+    }
+
+    if (svd_verbose) {
+        fprintf(stderr, "  svd: Lanczos: %d restarts\n", it);
+        fflush(stderr);
+    }
+
+    ritzvec(m, p, k, P, X, T);
+    for (i = 0; i < m; i++)
+        for (j = 0; j < k; j++)
+            U[i][j] = T[j][i];
+    ritzvec(n, p, k, Q, Y, T);
+    for (i = 0; i < n; i++)
+        for (j = 0; j < k; j++)
+            V[i][j] = T[j][i];
+    memcpy(w, s, k * sizeof(double));
+
+    free2d(P);
+    free2d(Q);
+    free2d(T);
+    free2d(B);
+    free2d(X);
+    free2d(Y);
+    free(s);
+    free(f);
+}
@@ -0,0 +1,399 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <float.h>
+
+#include "svd.hpp"
+#include "svd_internal.hpp"
+
+/* Orthogonalises x against the columns U[0..m-1][0..k-1] by classical
+ * Gram-Schmidt, twice, and then against the rows X[0..j-1] (see reorth()).
+ * @return Norm of x after orthogonalisation
+ */
+static double orth(int m, int k, double** U, double* x, double** X, int j)
+{
+    double* c = (double*)(malloc((k > 0 ? k : 1) * sizeof(double)));
+    int pass, i, l;
+
+    for (pass = 0; pass < 2; pass++) {
+        memset(c, 0, k * sizeof(double));
+        for (i = 0; i < m; i++)
+            for (l = 0; l < k; l++)
+                c[l] += U[i][l] * x[i];
+        for (i = 0; i < m; i++)
+            for (l = 0; l < k; l++)
+                x[i] -= c[l] * U[i][l];
+    }
+    free(c);
+
+    return reorth(m, x, X, j);
+}
+
+/* Extends the orthonormal columns U[0..m-1][0..k-1] by the orthonormalised
+ * parts of the vectors X[0..c-1][0..m-1] outside their span: on exit the
+ * columns of L [0..m-1][0..k+p-1] are U followed by the p <= c new vectors.
+ * Vectors that lie in the span of the previous ones (to rounding) are
+ * skipped.
+ * @return p
+ */
+static int extend(int m, int k, double** U, int c, double** X, double** L)
+{
+    double** P = (double**)(alloc2d(m, c, sizeof(double)));
+    int p = 0;
+    int i, j;
+
+    for (j = 0; j < c; j++) {
+        double s = 0.0;
+        double nrm;
+
+        memcpy(P[p], X[j], m * sizeof(double));
+        for (i = 0; i < m; i++)
+            s += P[p][i] * P[p][i];
+        nrm = orth(m, k, U, P[p], P, p);
+        if (nrm <= m * DBL_EPSILON * sqrt(s) || k + p == m)
+            continue;
+        for (i = 0; i < m; i++)
+            P[p][i] /= nrm;
+        p++;
+    }
+    for (i = 0; i < m; i++) {
+        memcpy(L[i], U[i], k * sizeof(double));
+        for (j = 0; j < p; j++)
+            L[i][k + j] = P[j][i];
+    }
+    free2d(P);
+
+    return p;
+}
+
+/* Decomposes the sl x sr core matrix K = Uk.Wk.Vk' and forms the leading
+ * triplets of L.K.R': U1 = L.Uk, V1 = R.Vk.
+ * @param sl Number of rows of K
+ * @param sr Number of columns of K
+ * @param K Core matrix; destroyed
+ * @param m Number of rows of L
+ * @param L Left basis [0..m-1][0..sl-1]
+ * @param n Number of rows of R
+ * @param R Right basis [0..n-1][0..sr-1]
+ * @param kk Maximal number of triplets
+ * @param U1 Output matrix [0..m-1][0..kk-1]
+ * @param w1 Output vector [0..kk-1] (decreasing)
+ * @param V1 Output matrix [0..n-1][0..kk-1]
+ * @return Number of triplets, min(kk,sl,sr)
+ */
+static int recombine(int sl, int sr, double** K, int m, double** L, int n, double** R, int kk, double** U1, double* w1, double** V1)
+{
+    int s = (sl < sr) ? sl : sr;
+    double** Vk = (double**)(alloc2d(s, sr, sizeof(double)));
+    double* wk = (double*)(malloc(s * sizeof(double)));
+
+    if (kk > s)
+        kk = s;
+    svd(K, sr, sl, wk, Vk);
+    svd_sort(K, sr, sl, wk, Vk);
+    matmul(m, kk, sl, L, K, U1);
+    matmul(n, kk, sr, R, Vk, V1);
+    memcpy(w1, wk, kk * sizeof(double));
+
+    free2d(Vk);
+    free(wk);
+
+    return kk;
+}
+
+/* Appends rows to a decomposition; see svd_addrows(). The new rows are
+ * given as the rows of B [0..r-1][0..n-1].
+ */
+static int addrows(int m, int n, int k, double** U, double* w, double** V, int r, double** B, int kk, double** U1, double* w1, double** V1)
+{
+    double** L = (double**)(alloc2d(k + r, m + r, sizeof(double)));
+    double** R = (double**)(alloc2d(k + r, n, sizeof(double)));
+    double** K = (double**)(alloc2d(k + r, k + r, sizeof(double)));
+    int i, j, l, p;
+
+    /*
+     * [U 0; 0 I]' [A; B] [V Q] = [W 0; B.V B.Q], where the p columns of Q
+     * complete those of V to span the new rows
+     */
+    p = extend(n, k, V, r, B, R);
+    for (i = 0; i < m; i++)
+        memcpy(L[i], U[i], k * sizeof(double));
+    for (i = 0; i < r; i++)
+        L[m + i][k + i] = 1.0;
+    for (i = 0; i < k; i++)
+        K[i][i] = w[i];
+    for (i = 0; i < r; i++)
+        for (l = 0; l < n; l++) {
+            double b = B[i][l];
+
+            if (b == 0.0)
+                continue;
+            for (j = 0; j < k + p; j++)
+                K[k + i][j] += b * R[l][j];
+        }
+
+    kk = recombine(k + r, k + p, K, m + r, L, n, R, kk, U1, w1, V1);
+
+    free2d(L);
+    free2d(R);
+    free2d(K);
+
+    return kk;
+}
+
+/** Updates a (possibly truncated) singular value decomposition
+ * A = U.W.V' for rows appended to A (Brand, 2006).
+ *
+ * The new rows are projected onto V and the remainder is orthonormalised,
+ * which leaves a small core matrix of order k+r to be decomposed by svd();
+ * the new singular vectors are the old ones, extended, rotated by those of
+ * the core. The cost is O((m+n).(k+r)^2), so a decomposition can be kept
+ * up to date as rows arrive at much less than the cost of recomputing it.
+ * With k < rank(A) the result is that of the truncated A.
+ *
+ * @param m Number of rows of A
+ * @param n Number of columns of A
+ * @param k Rank of the decomposition
+ * @param U Input matrix U [0..m-1][0..k-1]
+ * @param w Input vector [0..k-1] of singular values
+ * @param V Input matrix V [0..n-1][0..k-1]
+ * @param r Number of new rows
+ * @param B New rows [0..r-1][0..n-1]
+ * @param kk Maximal rank of the updated decomposition
+ * @param U1 Output matrix U [0..m+r-1][0..kk-1]
+ * @param w1 Output vector [0..kk-1] of singular values (decreasing)
+ * @param V1 Output matrix V [0..n-1][0..kk-1]
+ * @return Rank of the updated decomposition: kk, or less if the new rows do
+ *         not add as many dimensions to the row space
+ */
+int svd_addrows(int m, int n, int k, double** U, double* w, double** V, int r, double** B, int kk, double** U1, double* w1, double** V1)
+{
+    if (kk <= 0)
+        quit("svd_addrows(): kk = %d; expected kk > 0\n", kk);
+
+    return addrows(m, n, k, U, w, V, r, B, kk, U1, w1, V1);
+}
+
+/** Updates a (possibly truncated) singular value decomposition
+ * A = U.W.V' for columns appended to A.
+ *
+ * Same as svd_addrows() for A'.
+ *
+ * @param m Number of rows of A
+ * @param n Number of columns of A
+ * @param k Rank of the decomposition
+ * @param U Input matrix U [0..m-1][0..k-1]
+ * @param w Input vector [0..k-1] of singular values
+ * @param V Input matrix V [0..n-1][0..k-1]
+ * @param c Number of new columns
+ * @param C New columns [0..m-1][0..c-1]
+ * @param kk Maximal rank of the updated decomposition
+ * @param U1 Output matrix U [0..m-1][0..kk-1]
+ * @param w1 Output vector [0..kk-1] of singular values (decreasing)
+ * @param V1 Output matrix V [0..n+c-1][0..kk-1]
+ * @return Rank of the updated decomposition
+ */
+int svd_addcols(int m, int n, int k, double** U, double* w, double** V, int c, double** C, int kk, double** U1, double* w1, double** V1)
+{
+    double** Ct;
+    int i, j;
+
+    if (kk <= 0)
+        quit("svd_addcols(): kk = %d; expected kk > 0\n", kk);
+
+    Ct = (double**)(alloc2d(m, c, sizeof(double)));
+    for (i = 0; i < m; i++)
+        for (j = 0; j < c; j++)
+            Ct[j][i] = C[i][j];
+    kk = addrows(n, m, k, V, w, U, c, Ct, kk, V1, w1, U1);
+    free2d(Ct);
+
+    return kk;
+}
+
+/** Updates a (possibly truncated) singular value decomposition
+ * A = U.W.V' for a low-rank modification A + X.Y' (Brand, 2006).
+ *
+ * The columns of X and Y are projected onto U and V and the remainders are
+ * orthonormalised, which leaves a core matrix of order at most k+c to be
+ * decomposed by svd(). A rank-one modification A + x.y' is the case c = 1.
+ * The cost is O((m+n).(k+c)^2).
+ *
+ * @param m Number of rows of A
+ * @param n Number of columns of A
+ * @param k Rank of the decomposition
+ * @param U Input matrix U [0..m-1][0..k-1]
+ * @param w Input vector [0..k-1] of singular values
+ * @param V Input matrix V [0..n-1][0..k-1]
+ * @param c Rank of the modification
+ * @param X Input matrix X [0..m-1][0..c-1]
+ * @param Y Input matrix Y [0..n-1][0..c-1]
+ * @param kk Maximal rank of the updated decomposition
+ * @param U1 Output matrix U [0..m-1][0..kk-1]
+ * @param w1 Output vector [0..kk-1] of singular values (decreasing)
+ * @param V1 Output matrix V [0..n-1][0..kk-1]
+ * @return Rank of the updated decomposition
+ */
+int svd_update(int m, int n, int k, double** U, double* w, double** V, int c, double** X, double** Y, int kk, double** U1, double* w1, double** V1)
+{
+    double** Xt;
+    double** Yt;
+    double** L;
+    double** R;
+    double** Mx;
+    double** My;
+    double** K;
+    int i, j, l, px, py;
+
+    if (kk <= 0)
+        quit("svd_update(): kk = %d; expected kk > 0\n", kk);
+
+    Xt = (double**)(alloc2d(m, c, sizeof(double)));
+    Yt = (double**)(alloc2d(n, c, sizeof(double)));
+    L = (double**)(alloc2d(k + c, m, sizeof(double)));
+    R = (double**)(alloc2d(k + c, n, sizeof(double)));
+    Mx = (double**)(alloc2d(c, k + c, sizeof(double)));
+    My = (double**)(alloc2d(c, k + c, sizeof(double)));
+    K = (double**)(alloc2d(k + c, k + c, sizeof(double)));
+
+    for (i = 0; i < m; i++)
+        for (j = 0; j < c; j++)
+            Xt[j][i] = X[i][j];
+    for (i = 0; i < n; i++)
+        for (j = 0; j < c; j++)
+            Yt[j][i] = Y[i][j];
+    px = extend(m, k, U, c, Xt, L);
+    py = extend(n, k, V, c, Yt, R);
+
+    /*
+     * [U P]' (U.W.V' + X.Y') [V Q] = [W 0; 0 0] + ([U P]'.X).([V Q]'.Y)'
+     */
+    for (i = 0; i < m; i++)
+        for (l = 0; l < k + px; l++)
+            for (j = 0; j < c; j++)
+                Mx[l][j] += L[i][l] * X[i][j];
+    for (i = 0; i < n; i++)
+        for (l = 0; l < k + py; l++)
+            for (j = 0; j < c; j++)
+                My[l][j] += R[i][l] * Y[i][j];
+    for (i = 0; i < k; i++)
+        K[i][i] = w[i];
+    for (i = 0; i < k + px; i++)
+        for (l = 0; l < k + py; l++)
+            for (j = 0; j < c; j++)
+                K[i][l] += Mx[i][j] * My[l][j];
+
+    kk = recombine(k + px, k + py, K, m, L, n, R, kk, U1, w1, V1);
+
+    free2d(Xt);
+    free2d(Yt);
+    free2d(L);
+    free2d(R);
+    free2d(Mx);
+    free2d(My);
+    free2d(K);
+
+    return kk;
+}
+
+/** Downdates a (possibly truncated) singular value decomposition
+ * A = U.W.V' for the removal of a row of A.
+ *
+ * With u the row of U being removed and H a reflector that takes u to a
+ * multiple of e_k, the remaining rows of U.H have k-1 orthonormal columns
+ * and a last column of norm (1 - |u|^2)^1/2 orthogonal to them, so that
+ * only the k x k core matrix diag(1,..,1,(1 - |u|^2)^1/2).H.W is left to
+ * be decomposed by svd(). The cost is O((m+n).k^2).
+ *
+ * @param m Number of rows of A
+ * @param n Number of columns of A
+ * @param k Rank of the decomposition
+ * @param U Input matrix U [0..m-1][0..k-1]
+ * @param w Input vector [0..k-1] of singular values
+ * @param V Input matrix V [0..n-1][0..k-1]
+ * @param row Index of the row to remove, 0 <= row < m
+ * @param kk Maximal rank of the downdated decomposition
+ * @param U1 Output matrix U [0..m-2][0..kk-1]
+ * @param w1 Output vector [0..kk-1] of singular values (decreasing)
+ * @param V1 Output matrix V [0..n-1][0..kk-1]
+ * @return Rank of the downdated decomposition: kk, or less if the row
+ *         carried a direction of the row space of its own
+ */
+int svd_delrow(int m, int n, int k, double** U, double* w, double** V, int row, int kk, double** U1, double* w1, double** V1)
+{
+    double** Ur;
+    double** L;
+    double** Lt;
+    double** H;
+    double** K;
+    double* u;
+    double* v;
+    double unrm = 0.0;
+    double vv = 0.0;
+    double d;
+    int i, j, l, sl;
+
+    if (m < 2)
+        quit("svd_delrow(): m = %d; expected m > 1\n", m);
+    if (row < 0 || row >= m)
+        quit("svd_delrow(): row = %d; expected 0 <= row < m = %d\n", row, m);
+    if (kk <= 0)
+        quit("svd_delrow(): kk = %d; expected kk > 0\n", kk);
+
+    Ur = (double**)(alloc2d(k, m - 1, sizeof(double)));
+    L = (double**)(alloc2d(k, m - 1, sizeof(double)));
+    Lt = (double**)(alloc2d(m - 1, k, sizeof(double)));
+    H = (double**)(alloc2d(k, k, sizeof(double)));
+    K = (double**)(alloc2d(k, k, sizeof(double)));
+    u = U[row];
+    v = (double*)(malloc(k * sizeof(double)));
+
+    /*
+     * H = I - 2.v.v'/(v'.v), v = u + sign(u_k).|u|.e_k
+     */
+    for (l = 0; l < k; l++)
+        unrm += u[l] * u[l];
+    unrm = sqrt(unrm);
+    memcpy(v, u, k * sizeof(double));
+    v[k - 1] += copysign(unrm, u[k - 1]);
+    for (l = 0; l < k; l++)
+        vv += v[l] * v[l];
+    for (i = 0; i < k; i++)
+        for (j = 0; j < k; j++)
+            H[i][j] = ((i == j) ? 1.0 : 0.0) - ((vv > 0.0) ? 2.0 * v[i] * v[j] / vv : 0.0);
+
+    /*
+     * L = (U without the row).H, with the last column reorthogonalised and
+     * normalised, or dropped if the row held all of it
+     */
+    for (i = 0, l = 0; i < m; i++)
+        if (i != row)
+            memcpy(Ur[l++], U[i], k * sizeof(double));
+    matmul(m - 1, k, k, Ur, H, L);
+    for (i = 0; i < m - 1; i++)
+        for (j = 0; j < k; j++)
+            Lt[j][i] = L[i][j];
+    d = reorth(m - 1, Lt[k - 1], Lt, k - 1);
+    sl = k;
+    if (d <= sqrt((double) m) * DBL_EPSILON)
+        sl = k - 1;
+    else
+        for (i = 0; i < m - 1; i++)
+            L[i][k - 1] = Lt[k - 1][i] / d;
+
+    for (i = 0; i < sl; i++)
+        for (j = 0; j < k; j++)
+            K[i][j] = H[i][j] * w[j] * ((i == k - 1) ? d : 1.0);
+
+    kk = (sl > 0) ? recombine(sl, k, K, m - 1, L, n, V, kk, U1, w1, V1) : 0;
+
+    free2d(Ur);
+    free2d(L);
+    free2d(Lt);
+    free2d(H);
+    free2d(K);
+    free(v);
+
+    return kk;
+}
@@ -0,0 +1,210 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <float.h>
+
+#include "svd.hpp"
+#include "svd_fixed.hpp"
+
+#define CHECK_TOL 100.0         /* accepted error, in units of
+                                 * max(m,n).DBL_EPSILON */
+
+static unsigned long long rng_state = 0x9e3779b97f4a7c15ULL;
+
+static double urand()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (rng_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Largest entry of |U'.U - I| for U [0..m-1][0..k-1]. */
+static double orth(double** U, int m, int k)
+{
+    double e = 0.0;
+    int i, j, l;
+
+    for (i = 0; i < k; i++)
+        for (j = 0; j < k; j++) {
+            double s = 0.0;
+
+            for (l = 0; l < m; l++)
+                s += U[l][i] * U[l][j];
+            e = fmax(e, fabs(s - ((i == j) ? 1.0 : 0.0)));
+        }
+    return e;
+}
+
+/* Checks the decomposition U.W.V' of A0 returned by an svd() variant.
+ * @return 0 if U and V are orthonormal and U.W.V' = A0 to the accuracy
+ *         CHECK_TOL, 1 otherwise
+ */
+static int check_usv(const char* name, double** A0, int n, int m, double** U, double* w, double** V)
+{
+    int k = (m < n) ? m : n;
+    double tol = CHECK_TOL * ((m > n) ? m : n) * DBL_EPSILON;
+    double anorm = 0.0, res = 0.0, ou, ov;
+    int i, j, l, bad = 0;
+
+    for (i = 0; i < m; i++)
+        for (j = 0; j < n; j++) {
+            double s = 0.0;
+
+            for (l = 0; l < k; l++)
+                s += U[i][l] * w[l] * V[j][l];
+            res = fmax(res, fabs(s - A0[i][j]));
+            anorm = fmax(anorm, fabs(A0[i][j]));
+        }
+    for (l = 0; l < k; l++)
+        bad |= !(w[l] >= 0.0);
+    ou = orth(U, m, k);
+    ov = orth(V, n, k);
+    res = (anorm > 0.0) ? res / anorm : res;
+    bad |= !(ou <= tol) || !(ov <= tol) || !(res <= tol);
+    printf("%-4s %-40s orthU %.1e orthV %.1e residual %.1e\n", bad ? "FAIL" : "ok", name, ou, ov, res);
+    return bad;
+}
+
+/* Decomposes A (m x n) with svd_jacobi() and checks the result. */
+static int check_jacobi(const char* name, double** A, int n, int m)
+{
+    int k = (m < n) ? m : n;
+    double** A0 = (double**)(alloc2d(n, m, sizeof(double)));
+    double** V = (double**)(alloc2d(k, n, sizeof(double)));
+    double* w = (double*)(malloc(k * sizeof(double)));
+    int i, j, bad;
+
+    for (i = 0; i < m; i++)
+        for (j = 0; j < n; j++)
+            A0[i][j] = A[i][j];
+    svd_jacobi(A, n, m, w, V);
+    bad = check_usv(name, A0, n, m, A, w, V);
+
+    free(w);
+    free2d(V);
+    free2d(A0);
+    return bad;
+}
+
+/* Rank-deficient inputs of svd_jacobi(): columns that hold only rounding
+ * noise after the rotations must not be rotated against each other.
+ */
+static int check_jacobi_rank()
+{
+    double** A;
+    int i, j, bad = 0;
+
+    A = (double**)(alloc2d(10, 30, sizeof(double)));
+    for (i = 0; i < 30; i++)
+        for (j = 0; j < 10; j++)
+            A[i][j] = 1.0;
+    bad += check_jacobi("svd_jacobi 30x10 all ones", A, 10, 30);
+    free2d(A);
+
+    A = (double**)(alloc2d(20, 20, sizeof(double)));
+    for (i = 0; i < 20; i++)
+        for (j = 0; j < 20; j++)
+            A[i][j] = (j % 4 == 0) ? 1.0 : 0.0;
+    bad += check_jacobi("svd_jacobi 20x20 every 4th column ones", A, 20, 20);
+    free2d(A);
+
+    A = (double**)(alloc2d(60, 60, sizeof(double)));
+    for (i = 0; i < 60; i++)
+        for (j = 0; j < 60; j++)
+            A[i][j] = ((j % 5 == 0) ? 1.0 : 0.0) + 1e-9 * (urand() - 0.5);
+    bad += check_jacobi("svd_jacobi 60x60 every 5th ones + 1e-9", A, 60, 60);
+    free2d(A);
+
+    return bad;
+}
+
+/* svd_mixed() of a random 40x30 matrix, scaled by 1e200 and with its
+ * columns graded down to 1e-20 (which falls back to svd()), and of its
+ * transpose.
+ */
+static int check_mixed()
+{
+    const char* names[] = { "svd_mixed %dx%d", "svd_mixed %dx%d scaled 1e200", "svd_mixed %dx%d graded 1e-20" };
+    int bad = 0;
+    int c, t, i, j;
+
+    for (t = 0; t < 2; t++)
+        for (c = 0; c < 3; c++) {
+            int m = t ? 30 : 40;
+            int n = t ? 40 : 30;
+            int k = (m < n) ? m : n;
+            double** A = (double**)(alloc2d(n, m, sizeof(double)));
+            double** A0 = (double**)(alloc2d(n, m, sizeof(double)));
+            double** V = (double**)(alloc2d(k, n, sizeof(double)));
+            double* w = (double*)(malloc(k * sizeof(double)));
+            char name[64];
+
+            for (i = 0; i < m; i++)
+                for (j = 0; j < n; j++) {
+                    double x = urand() - 0.5;
+
+                    if (c == 1)
+                        x *= 1e200;
+                    else if (c == 2)
+                        x *= pow(10.0, -20.0 * j / n);
+                    A[i][j] = A0[i][j] = x;
+                }
+            svd_mixed(A, n, m, w, V);
+            snprintf(name, sizeof(name), names[c], m, n);
+            bad += check_usv(name, A0, n, m, A, w, V);
+
+            free(w);
+            free2d(V);
+            free2d(A0);
+            free2d(A);
+        }
+    return bad;
+}
+
+/* svd_fixed() of I - J/L (rank L - 1): the complement of the range is
+ * spread evenly over the unit vectors, so that none of them stands out for
+ * completing U.
+ */
+template <int L>
+static int check_fixed_centering()
+{
+    double a[L][L], w[L], v[L][L];
+    double** A0 = (double**)(alloc2d(L, L, sizeof(double)));
+    double** U = (double**)(alloc2d(L, L, sizeof(double)));
+    double** V = (double**)(alloc2d(L, L, sizeof(double)));
+    char name[64];
+    int i, j, bad;
+
+    for (i = 0; i < L; i++)
+        for (j = 0; j < L; j++)
+            a[i][j] = A0[i][j] = ((i == j) ? 1.0 : 0.0) - 1.0 / L;
+    svd_fixed<L, L, double>(a, w, v);
+    for (i = 0; i < L; i++)
+        for (j = 0; j < L; j++) {
+            U[i][j] = a[i][j];
+            V[i][j] = v[i][j];
+        }
+    snprintf(name, sizeof(name), "svd_fixed %dx%d I - J/%d", L, L, L);
+    bad = check_usv(name, A0, L, L, U, w, V);
+
+    free2d(V);
+    free2d(U);
+    free2d(A0);
+    return bad;
+}
+
+int main()
+{
+    int bad = 0;
+
+    bad += check_jacobi_rank();
+    bad += check_fixed_centering<3>();
+    bad += check_fixed_centering<4>();
+    bad += check_fixed_centering<5>();
+    bad += check_mixed();
+
+    if (bad)
+        printf("%d check(s) failed\n", bad);
+    return bad ? 1 : 0;
+}